@@ -0,0 +1,106 @@
+/** Copyright (C) 2015-2017 Mingxin Wang - All Rights Reserved.
+ *  This is a C++ source file, and is also a benchmark for
+ *  the Concurrent Support Library.
+ *
+ *  @file     benchmark_10_reducer.cc
+ *  @author   Mingxin Wang
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "../solution/concurrent.h"
+
+using Clock = std::chrono::steady_clock;
+
+constexpr std::size_t BINS = 16u;
+
+std::uint64_t value_of(std::size_t task, std::size_t i) {                       /// A cheap pseudo-random value per update
+  std::uint64_t x = (std::uint64_t)task * 0x9E3779B97F4A7C15u + i;
+  x ^= x >> 29;
+  return x * 0xBF58476D1CE4E5B9u >> 40;
+}
+
+int main(int argc, char** argv) {
+  std::size_t tasks = argc > 1 ? std::strtoul(argv[1], nullptr, 10)
+                               : 256u;                                          /// Usage: benchmark_10_reducer [tasks] [updates_per_task] [threads]
+  std::size_t updates = argc > 2 ? std::strtoul(argv[2], nullptr, 10)
+                                 : 100000u;
+  std::size_t threads = argc > 3 ? std::strtoul(argv[3], nullptr, 10)
+                                 : std::thread::hardware_concurrency();
+  con::abstraction::ConcurrentCallablePortal thread_pool_portal(                /// Construct a con::ThreadPoolPortal and wrap it into an abstraction
+      con::ThreadPoolPortal<>(std::max<std::size_t>(threads, 1u)));
+  auto invoke = [&](auto update, auto&... reducers) {                           /// Returns the million updates per second
+    auto make_callable = [&](std::size_t task) {
+      return con::make_concurrent_callable(
+          thread_pool_portal, con::make_concurrent_procedure([=]() mutable {
+            for (std::size_t i = 0u; i < updates; ++i) {
+              update(value_of(task, i));
+            }
+          }));
+    };
+    con::ConcurrentCaller1D<decltype(make_callable(0u))> caller;
+    for (std::size_t i = 0u; i < tasks; ++i) {
+      caller.emplace(make_callable(i));
+    }
+    con::HelpingBinarySemaphore semaphore;
+    Clock::time_point start = Clock::now();
+    con::async_concurrent_invoke(                                               /// The views are merged before the callback releases the semaphore
+        con::make_reducing_callback(
+            con::SyncConcurrentCallback<con::HelpingBinarySemaphore>(semaphore),
+            reducers...),
+        caller);
+    semaphore.wait();
+    std::chrono::duration<double> elapsed = Clock::now() - start;
+    return (double)tasks * updates / 1e6 / elapsed.count();
+  };
+
+  std::atomic<std::uint64_t> shared_sum(0u), shared_max(0u);                    /// Every update goes to the same cache lines
+  std::vector<std::atomic<std::uint64_t>> shared_bins(BINS);
+  double atomic_rate = invoke([&](std::uint64_t value) {
+    shared_sum.fetch_add(value, std::memory_order_relaxed);
+    shared_bins[value % BINS].fetch_add(1u, std::memory_order_relaxed);
+    std::uint64_t last = shared_max.load(std::memory_order_relaxed);
+    while (last < value && !shared_max.compare_exchange_weak(
+        last, value, std::memory_order_relaxed)) {}
+  });
+
+  con::Reducer<con::SumMonoid<std::uint64_t>> sum;                              /// Every thread updates its own views
+  con::Reducer<con::MaxMonoid<std::uint64_t>> max;
+  con::Reducer<con::HistogramMonoid> bins(con::HistogramMonoid{BINS});
+  double reducer_rate = invoke([&](std::uint64_t value) {
+    sum.view() += value;
+    ++bins.view()[value % BINS];
+    std::uint64_t& view = max.view();
+    view = std::max(view, value);
+  }, sum, max, bins);
+
+  con::Reducer<con::AppendMonoid<std::uint64_t>> odd;                           /// Collects the odd values
+  invoke([&](std::uint64_t value) {
+    if (value % 2u == 1u) {
+      odd.view().push_back(value);
+    }
+  }, odd);
+
+  bool ok = sum.result() == shared_sum.load() &&
+      max.result() == shared_max.load();
+  std::uint64_t odd_count = 0u;
+  for (std::size_t i = 0u; i < BINS; ++i) {
+    ok &= bins.result()[i] == shared_bins[i].load();
+    odd_count += i % 2u == 1u ? shared_bins[i].load() : 0u;
+  }
+  ok &= odd.result().size() == odd_count;
+  std::cout << "{\"benchmark\": \"reducer\", \"tasks\": " << tasks
+            << ", \"updates_per_task\": " << updates << ", \"threads\": "
+            << threads << ",\n  \"atomic_mupdates_s\": " << atomic_rate
+            << ", \"reducer_mupdates_s\": " << reducer_rate
+            << ", \"verified\": " << (ok ? "true" : "false") << "}"
+            << std::endl;
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,129 @@
+/** Copyright (C) 2015-2017 Mingxin Wang - All Rights Reserved.
+ *  This is a C++ source file, and is also a benchmark for
+ *  the Concurrent Support Library.
+ *
+ *  @file     benchmark_11_phase_handoff.cc
+ *  @author   Mingxin Wang
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "../solution/concurrent.h"
+
+using Clock = std::chrono::steady_clock;
+
+class PoolPortal {                                                              /// Refers to the pool, and hides the handoff if asked to, so that every phase is queued
+ public:
+  PoolPortal(const con::ThreadPoolPortal<>& pool, bool handoff)
+      : pool_(&pool), handoff_(handoff) {}
+
+  template <class F, class... Args>
+  void operator()(F&& f, Args&&... args) const {
+    con::PhaseHandoffScope scope(handoff_ &&
+                                 con::current_phase_handoff().pending_);
+    (*pool_)(std::forward<F>(f), std::forward<Args>(args)...);
+  }
+
+ private:
+  const con::ThreadPoolPortal<>* pool_;
+  bool handoff_;
+};
+
+double run(const PoolPortal& portal,
+           std::vector<std::vector<std::uint64_t>>& buffers,
+           std::size_t rounds, std::atomic<std::uint64_t>& sink) {              /// Returns the milliseconds per round
+  auto make_callable = [&](std::size_t i) {
+    std::uint64_t* data = buffers[i].data();
+    std::size_t size = buffers[i].size();
+    return con::make_multi_phase_concurrent_callable(
+        con::make_concurrent_phase(portal, con::make_concurrent_procedure([=] { /// The first phase writes the buffer of the task
+          for (std::size_t j = 0u; j < size; ++j) {
+            data[j] = j * (i + 1u);
+          }
+        })),
+        con::make_concurrent_phase(portal, con::make_concurrent_procedure(
+            [=, &sink] {                                                        /// The second phase reads it back a few times
+              std::uint64_t sum = 0u;
+              for (int pass = 0; pass < 4; ++pass) {
+                for (std::size_t j = 0u; j < size; ++j) {
+                  sum += data[j] >> pass;
+                }
+              }
+              sink.fetch_add(sum, std::memory_order_relaxed);
+            })));
+  };
+  Clock::time_point start = Clock::now();
+  for (std::size_t r = 0u; r < rounds; ++r) {
+    con::ConcurrentCaller1D<decltype(make_callable(0u))> caller;
+    for (std::size_t i = 0u; i < buffers.size(); ++i) {
+      caller.emplace(make_callable(i));
+    }
+    con::sync_concurrent_invoke([] {}, caller);
+  }
+  std::chrono::duration<double, std::milli> elapsed = Clock::now() - start;
+  return elapsed.count() / rounds;
+}
+
+std::uint64_t run_fan_out(const con::ThreadPoolPortal<>& pool,
+                          std::size_t tasks, std::size_t fan_out) {
+  PoolPortal portal(pool, true);
+  std::atomic<std::uint64_t> done(0u);
+  auto make_callable = [&] {
+    return con::make_multi_phase_concurrent_callable(
+        con::make_concurrent_phase(portal, con::make_concurrent_procedure(
+            [] {})),
+        con::make_concurrent_phase(con::SerialPortal(),                         /// The second phase runs inline, and fans out to the pool
+                                   con::make_concurrent_procedure([&] {
+          auto caller = con::make_concurrent_caller(
+              fan_out, con::make_concurrent_callable(
+                  portal, con::make_concurrent_procedure([&] { ++done; })));
+          con::sync_concurrent_invoke_explicit(                                 /// Helps the pool while waiting, for the phase runs on a worker
+              con::BasicAtomicCounter::Initializer(),
+              con::HelpingBinarySemaphore(), [] {}, caller);
+        })));
+  };
+  std::uint64_t before = pool.metrics().total().continued_;
+  con::ConcurrentCaller1D<decltype(make_callable())> caller;
+  for (std::size_t i = 0u; i < tasks; ++i) {
+    caller.emplace(make_callable());
+  }
+  con::sync_concurrent_invoke([] {}, caller);
+  return done.load() == tasks * fan_out                                         /// Returns the fan-out tasks run inline, which shall be none
+      ? pool.metrics().total().continued_ - before : tasks * fan_out;
+}
+
+int main(int argc, char** argv) {
+  std::size_t tasks = argc > 1 ? std::strtoul(argv[1], nullptr, 10)
+                               : 64u;                                           /// Usage: benchmark_11_phase_handoff [tasks] [buffer_kb] [rounds]
+  std::size_t buffer_kb = argc > 2 ? std::strtoul(argv[2], nullptr, 10)
+                                   : 256u;
+  std::size_t rounds = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 20u;
+  std::size_t threads = std::max(1u, std::thread::hardware_concurrency());
+  std::vector<std::vector<std::uint64_t>> buffers(
+      tasks, std::vector<std::uint64_t>(buffer_kb * 1024u / 8u));
+  std::atomic<std::uint64_t> sink(0u);
+  con::ThreadPoolPortal<> pool(threads);
+  run(PoolPortal(pool, true), buffers, 2u, sink);                               /// Warm up
+  std::uint64_t before = pool.metrics().total().continued_;
+  double queued = run(PoolPortal(pool, false), buffers, rounds, sink);
+  std::uint64_t after_queued = pool.metrics().total().continued_;
+  double continued = run(PoolPortal(pool, true), buffers, rounds, sink);
+  std::uint64_t after_continued = pool.metrics().total().continued_;
+  std::uint64_t fan_out_continued = run_fan_out(pool, tasks, 8u);
+  std::cout << "{\"benchmark\": \"phase_handoff\", \"tasks\": " << tasks
+            << ", \"buffer_kb\": " << buffer_kb << ", \"threads\": "
+            << threads << ",\n  \"queued_ms_per_round\": " << queued
+            << ", \"queued_continued_phases\": " << after_queued - before
+            << ",\n  \"continued_ms_per_round\": " << continued
+            << ", \"continued_phases\": " << after_continued - after_queued
+            << ",\n  \"fan_out_continued\": " << fan_out_continued << "}"
+            << std::endl;
+  return sink.load() == 0u || fan_out_continued != 0u ? 1 : 0;
+}
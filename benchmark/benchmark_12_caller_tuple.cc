@@ -0,0 +1,81 @@
+/** Copyright (C) 2015-2017 Mingxin Wang - All Rights Reserved.
+ *  This is a C++ source file, and is also a benchmark for
+ *  the Concurrent Support Library.
+ *
+ *  @file     benchmark_12_caller_tuple.cc
+ *  @author   Mingxin Wang
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <tuple>
+
+#include "../solution/concurrent.h"
+
+using Clock = std::chrono::steady_clock;
+
+struct State {
+  std::uint64_t sum_ = 0u, bits_ = 0u, max_ = 0u;
+};
+
+template <class F>
+double run(std::size_t rounds, F invoke) {                                      /// Returns the nanoseconds per invoke
+  Clock::time_point start = Clock::now();
+  for (std::size_t r = 0u; r < rounds; ++r) {
+    invoke(r);
+  }
+  std::chrono::duration<double, std::nano> elapsed = Clock::now() - start;
+  return elapsed.count() / rounds;
+}
+
+int main(int argc, char** argv) {
+  std::size_t rounds = argc > 1 ? std::strtoul(argv[1], nullptr, 10)
+                                : 1000000u;                                     /// Usage: benchmark_12_caller_tuple [rounds]
+  State erased, small, tuple;
+  auto make_callables = [](State& state, std::uint64_t r) {                     /// Three callables of different types, run on the calling thread
+    con::SerialPortal portal;
+    return std::make_tuple(
+        con::make_concurrent_callable(portal, con::make_concurrent_procedure(
+            [&state, r] { state.sum_ += r; })),
+        con::make_concurrent_callable(portal, con::make_concurrent_procedure(
+            [&state, r] { state.bits_ ^= r * 0x9E3779B97F4A7C15u; })),
+        con::make_concurrent_callable(portal, con::make_concurrent_procedure(
+            [&state, r] { state.max_ = std::max(state.max_, r % 1000u); })));
+  };
+
+  double erased_ns = run(rounds, [&](std::uint64_t r) {                         /// Erased into con::abstraction::ConcurrentCallable, stored in a std::vector
+    con::ConcurrentCaller1D<> caller;
+    std::apply([&](auto&&... callables) { (caller.emplace(callables), ...); },
+               make_callables(erased, r));
+    con::sync_concurrent_invoke([] {}, caller);
+  });
+  double small_ns = run(rounds, [&](std::uint64_t r) {                          /// Erased, but stored inline
+    con::SmallConcurrentCaller1D<con::abstraction::ConcurrentCallable, 4u>
+        caller;
+    std::apply([&](auto&&... callables) { (caller.emplace(callables), ...); },
+               make_callables(small, r));
+    con::sync_concurrent_invoke([] {}, caller);
+  });
+  double tuple_ns = run(rounds, [&](std::uint64_t r) {                          /// Stored inline and called directly
+    auto caller = std::apply([](auto&&... callables) {
+      return con::make_concurrent_caller_tuple(callables...);
+    }, make_callables(tuple, r));
+    static_assert(con::count_call(caller) == 3u,
+                  "The size of a tuple caller is a constant expression");
+    con::sync_concurrent_invoke([] {}, caller);
+  });
+
+  bool ok = erased.sum_ == tuple.sum_ && erased.bits_ == tuple.bits_ &&
+      erased.max_ == tuple.max_ && small.sum_ == tuple.sum_ &&
+      small.bits_ == tuple.bits_ && small.max_ == tuple.max_;
+  std::cout << "{\"benchmark\": \"caller_tuple\", \"rounds\": " << rounds
+            << ",\n  \"erased_1d_ns\": " << erased_ns
+            << ", \"small_1d_ns\": " << small_ns
+            << ", \"tuple_ns\": " << tuple_ns
+            << ", \"verified\": " << (ok ? "true" : "false") << "}"
+            << std::endl;
+  return ok ? 0 : 1;
+}
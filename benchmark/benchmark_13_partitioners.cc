@@ -0,0 +1,119 @@
+/** Copyright (C) 2015-2017 Mingxin Wang - All Rights Reserved.
+ *  This is a C++ source file, and is also a benchmark for
+ *  the Concurrent Support Library.
+ *
+ *  @file     benchmark_13_partitioners.cc
+ *  @author   Mingxin Wang
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "../solution/concurrent.h"
+
+using Clock = std::chrono::steady_clock;
+using Portal = con::abstraction::ConcurrentCallablePortal;
+
+void spin(std::chrono::microseconds duration) {                                 /// Keeps a core busy, as an expensive element or another user of the pool would
+  Clock::time_point end = Clock::now() + duration;
+  while (Clock::now() < end) {}
+}
+
+void occupy(const Portal& portal, const std::atomic_bool& stop,
+            std::atomic_size_t& running) {                                      /// Keeps a worker of the pool busy in slices of 2 ms until stopped
+  con::async_concurrent_invoke(
+      [&portal, &stop, &running] {
+        if (stop.load()) {
+          running.fetch_sub(1u);
+        } else {
+          occupy(portal, stop, running);
+        }
+      },
+      con::make_concurrent_caller(
+          1u,
+          con::make_concurrent_callable(
+              con::copy_construct(portal),
+              con::make_concurrent_procedure(
+                  [] { spin(std::chrono::milliseconds(2)); }))));
+}
+
+struct Workload {
+  const char* name_;
+  std::size_t size_, rounds_;
+  std::chrono::microseconds cost_;                                              /// The cost of an element, the cheap elements only count their visits
+  std::size_t busy_;                                                            /// The workers of the pool taken by another user
+};
+
+template <class Partitioner>
+bool run(const char* name, Partitioner partitioner, const Workload& workload,
+         const Portal& portal, std::size_t concurrency, bool& first) {          /// Returns whether every element is visited once per round
+  std::vector<std::uint32_t> visits(workload.size_, 0u);
+  auto task = [&](std::size_t begin, std::size_t end) {
+    for (std::size_t i = begin; i < end; ++i) {
+      if (workload.cost_.count() != 0) {
+        spin(workload.cost_);
+      }
+      ++visits[i];
+    }
+  };
+  Clock::time_point start = Clock::now();
+  for (std::size_t r = 0u; r < workload.rounds_; ++r) {
+    partitioner(portal, workload.size_, concurrency, task);                     /// The same partitioner in every round, so that AutoPartitioner learns
+  }
+  std::chrono::duration<double, std::nano> elapsed = Clock::now() - start;
+  bool ok = std::all_of(visits.begin(), visits.end(), [&](std::uint32_t n) {
+    return n == workload.rounds_;
+  });
+  std::cout << (first ? "\n" : ",\n") << "    {\"workload\": \""
+            << workload.name_ << "\", \"partitioner\": \"" << name
+            << "\", \"ns_per_element\": "
+            << elapsed.count() / (workload.size_ * workload.rounds_)
+            << ", \"verified\": " << (ok ? "true" : "false") << "}";
+  first = false;
+  return ok;
+}
+
+int main(int argc, char** argv) {
+  std::size_t threads = argc > 1 ? std::strtoul(argv[1], nullptr, 10)
+      : std::max(2u, std::thread::hardware_concurrency());                      /// Usage: benchmark_13_partitioners [threads] [expensive_us]
+  std::chrono::microseconds cost(
+      argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 1000u);
+  threads = std::max<std::size_t>(threads, 1u);
+  Portal portal = con::ThreadPoolPortal<>(threads);
+  const Workload workloads[] = {
+      {"cheap", 1u << 20, 20u, std::chrono::microseconds(0), 0u},
+      {"expensive", 64u, 3u, cost, 0u},
+      {"expensive_busy_pool", 64u, 5u, cost, threads / 2u}};                    /// Half of the workers are taken, so that the blocks queued behind them are late
+  bool ok = true, first = true;
+  std::cout << "{\"benchmark\": \"partitioners\", \"threads\": " << threads
+            << ", \"results\": [";
+  for (const Workload& workload : workloads) {
+    std::atomic_bool stop(false);
+    std::atomic_size_t running(workload.busy_);
+    for (std::size_t i = 0u; i < workload.busy_; ++i) {
+      occupy(portal, stop, running);
+    }
+    ok &= run("static", con::StaticPartitioner(), workload, portal, threads,
+              first);
+    ok &= run("dynamic_1", con::DynamicPartitioner(1u), workload, portal,
+              threads, first);
+    ok &= run("dynamic_1024", con::DynamicPartitioner(1024u), workload,
+              portal, threads, first);
+    ok &= run("guided", con::GuidedPartitioner(), workload, portal, threads,
+              first);
+    ok &= run("auto", con::AutoPartitioner(), workload, portal, threads,
+              first);
+    stop.store(true);
+    while (running.load() != 0u) {
+      std::this_thread::yield();
+    }
+  }
+  std::cout << "\n  ]\n}" << std::endl;
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,56 @@
+/** Copyright (C) 2015-2017 Mingxin Wang - All Rights Reserved.
+ *  This is a C++ source file, and is also a benchmark for
+ *  the Concurrent Support Library.
+ *
+ *  @file     benchmark_1_multi_phase_concurrent_callable.cc
+ *  @author   Mingxin Wang
+ */
+
+#include <chrono>
+#include <iostream>
+
+#include "../solution/concurrent.h"
+
+constexpr std::size_t ITERATIONS = 100000u;
+constexpr std::size_t PHASES = 8u;
+
+auto make_phase() {                                                             /// Every phase runs an empty procedure serially, so only the overhead is measured
+  return con::make_concurrent_phase(con::SerialPortal(),
+                                    con::make_concurrent_procedure());
+}
+
+void invoke_dynamic() {
+  con::MultiPhaseConcurrentCallable<> callable;                                 /// Type-erased phases stored in a std::queue
+  for (std::size_t i = 0u; i < PHASES; ++i) {
+    callable.append_phase(con::SerialPortal(), con::make_concurrent_procedure());
+  }
+  con::sync_concurrent_invoke([] {}, con::make_concurrent_caller(callable));
+}
+
+void invoke_static() {
+  auto callable = con::make_multi_phase_concurrent_callable(                    /// Statically-typed phases, PHASES == 8
+      make_phase(), make_phase(), make_phase(), make_phase(),
+      make_phase(), make_phase(), make_phase(), make_phase());
+  con::sync_concurrent_invoke([] {}, con::make_concurrent_caller(callable));
+}
+
+template <class F>
+double measure(F f) {                                                           /// Returns the average overhead of one phase in nanoseconds
+  auto start = std::chrono::steady_clock::now();
+  for (std::size_t i = 0u; i < ITERATIONS; ++i) {
+    f();
+  }
+  std::chrono::duration<double, std::nano> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return elapsed.count() / (ITERATIONS * PHASES);
+}
+
+int main() {
+  measure(invoke_dynamic);                                                      /// Warm up
+  measure(invoke_static);
+  std::cout << "MultiPhaseConcurrentCallable:       "
+            << measure(invoke_dynamic) << " ns/phase" << std::endl;
+  std::cout << "StaticMultiPhaseConcurrentCallable: "
+            << measure(invoke_static) << " ns/phase" << std::endl;
+  return 0;
+}
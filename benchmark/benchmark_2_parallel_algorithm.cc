@@ -0,0 +1,82 @@
+/** Copyright (C) 2015-2017 Mingxin Wang - All Rights Reserved.
+ *  This is a C++ source file, and is also a benchmark for
+ *  the Concurrent Support Library.
+ *
+ *  @file     benchmark_2_parallel_algorithm.cc
+ *  @author   Mingxin Wang
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <vector>
+
+#include "../solution/concurrent.h"
+
+constexpr std::size_t N = 1u << 22;
+constexpr std::size_t REPEAT = 5u;
+
+volatile double sink;                                                           /// Keeps the results of the reductions alive
+
+template <class F>
+double measure(F f) {                                                           /// Returns the best elapsed time of several runs in milliseconds
+  double best = 1e30;
+  for (std::size_t i = 0u; i < REPEAT; ++i) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    std::chrono::duration<double, std::milli> elapsed =
+        std::chrono::steady_clock::now() - start;
+    best = std::min(best, elapsed.count());
+  }
+  return best;
+}
+
+void report(const char* name, double serial, double concurrent) {
+  std::cout << "  " << name << ": serial " << serial << " ms, concurrent "
+            << concurrent << " ms, speedup " << serial / concurrent << std::endl;
+}
+
+int main() {
+  std::vector<double> src(N), dest(N), data(N);
+  std::mt19937 gen(0u);
+  std::uniform_real_distribution<> dis(0.0, 1.0);
+  std::generate(src.begin(), src.end(), [&] { return dis(gen); });
+  auto heavy = [](double x) { return std::sqrt(x) * std::sin(x); };
+  std::size_t max_threads = std::max(1u, std::thread::hardware_concurrency());
+  for (std::size_t threads = 1u; threads <= max_threads; ++threads) {
+    con::abstraction::ConcurrentCallablePortal portal(                          /// The calling thread takes a block as well
+        con::ThreadPoolPortal<>(threads - 1u));
+    std::cout << threads << " thread(s):" << std::endl;
+    report("for_each",
+           measure([&] { std::for_each(dest.begin(), dest.end(),
+                                       [](double& x) { x *= 1.5; }); }),
+           measure([&] { con::concurrent_for_each(portal, dest.begin(), dest.end(),
+                                                  [](double& x) { x *= 1.5; },
+                                                  threads); }));
+    report("transform",
+           measure([&] { std::transform(src.begin(), src.end(), dest.begin(), heavy); }),
+           measure([&] { con::concurrent_transform(portal, src.begin(), src.end(),
+                                                   dest.begin(), heavy, threads); }));
+    report("reduce",
+           measure([&] { sink = std::accumulate(src.begin(), src.end(), 0.0); }),
+           measure([&] { sink = con::concurrent_reduce(
+               portal, src.begin(), src.end(), 0.0, std::plus<>(), threads); }));
+    report("inclusive_scan",
+           measure([&] { std::partial_sum(src.begin(), src.end(), dest.begin()); }),
+           measure([&] { con::concurrent_inclusive_scan(
+               portal, src.begin(), src.end(), dest.begin(), std::plus<>(),
+               threads); }));
+    report("sort",
+           measure([&] { data = src; std::sort(data.begin(), data.end()); }),
+           measure([&] { data = src; con::concurrent_sort(
+               portal, data.begin(), data.end(), std::less<>(), threads); }));
+    report("copy",
+           measure([&] { std::copy(src.begin(), src.end(), dest.begin()); }),
+           measure([&] { con::concurrent_copy(portal, src.begin(), src.end(),
+                                              dest.begin(), threads); }));
+  }
+  return 0;
+}
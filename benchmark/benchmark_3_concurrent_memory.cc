@@ -0,0 +1,57 @@
+/** Copyright (C) 2015-2017 Mingxin Wang - All Rights Reserved.
+ *  This is a C++ source file, and is also a benchmark for
+ *  the Concurrent Support Library.
+ *
+ *  @file     benchmark_3_concurrent_memory.cc
+ *  @author   Mingxin Wang
+ */
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include "../solution/concurrent.h"
+
+constexpr std::size_t MAX_SIZE = 1u << 28;
+constexpr std::size_t TOTAL_BYTES = 1u << 31;                                   /// Every size copies about the same amount of bytes in total
+
+template <class F>
+double measure(std::size_t n, F f) {                                            /// Returns the bandwidth in GB/s
+  std::size_t rounds = std::max<std::size_t>(1u, TOTAL_BYTES / n);
+  f();                                                                          /// Warm up, the pages are touched here
+  auto start = std::chrono::steady_clock::now();
+  for (std::size_t i = 0u; i < rounds; ++i) {
+    f();
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return (double)n * rounds / elapsed.count() / 1e9;
+}
+
+int main() {
+  std::vector<char> src(MAX_SIZE, 'x'), dest(MAX_SIZE);
+  std::size_t concurrency = std::max(1u, std::thread::hardware_concurrency());
+  con::abstraction::ConcurrentCallablePortal portal(                            /// The calling thread copies a block as well
+      con::ThreadPoolPortal<>(concurrency - 1u));
+  for (std::size_t n = 1u << 12; n <= MAX_SIZE; n <<= 2) {
+    std::cout << n << " bytes: memcpy "
+              << measure(n, [&] { std::memcpy(dest.data(), src.data(), n); })
+              << " GB/s, concurrent_memcpy "
+              << measure(n, [&] { con::concurrent_memcpy(
+                     portal, dest.data(), src.data(), n, concurrency); })
+              << " GB/s, concurrent_copy "                                      /// A "char*" source takes the byte path of concurrent_memcpy
+              << measure(n, [&] { con::concurrent_copy(
+                     portal, src.data(), src.data() + n, dest.data(),
+                     concurrency); })
+              << " GB/s, concurrent_copy (iterators) "                          /// The generic path, for comparison
+              << measure(n, [&] { con::concurrent_copy(
+                     portal, src.begin(), src.begin() + n, dest.begin(),
+                     concurrency); })
+              << " GB/s, concurrent_fill "
+              << measure(n, [&] { con::concurrent_fill(
+                     portal, dest.data(), dest.data() + n, 'y', concurrency); })
+              << " GB/s" << std::endl;
+  }
+  return 0;
+}
@@ -0,0 +1,178 @@
+/** Copyright (C) 2015-2017 Mingxin Wang - All Rights Reserved.
+ *  This is a C++ source file, and is also a benchmark for
+ *  the Concurrent Support Library.
+ *
+ *  @file     benchmark_4_binary_semaphore.cc
+ *  @author   Mingxin Wang
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <ctime>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../solution/concurrent.h"
+
+constexpr std::size_t CPU_BURN_SAMPLES = 20u;
+constexpr std::chrono::microseconds BLOCK_DELAY(50);                            /// Time given to the waiter to block before each release
+constexpr std::chrono::milliseconds CPU_BURN_WAIT(2);
+
+double thread_cpu_ns() {                                                        /// CPU time consumed by the calling thread
+#ifdef CLOCK_THREAD_CPUTIME_ID
+  timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+#else
+  return 0.;
+#endif // CLOCK_THREAD_CPUTIME_ID
+}
+
+double percentile(std::vector<double>& samples, double p) {
+  if (samples.empty()) {                                                        /// Reported as 0 when run with no samples
+    return 0.;
+  }
+  std::size_t i = std::min(samples.size() - 1u,
+                           (std::size_t)(p * samples.size()));
+  std::nth_element(samples.begin(), samples.begin() + i, samples.end());
+  return samples[i];
+}
+
+template <class BinarySemaphore>
+std::vector<double> measure_latency(std::size_t samples) {                      /// Nanoseconds from release() to the return of wait()
+  std::unique_ptr<BinarySemaphore[]> semaphores(new BinarySemaphore[samples]);  /// A fresh semaphore for every sample, as in sync_concurrent_invoke
+  std::vector<std::chrono::steady_clock::time_point> released(samples), woken(samples);
+  std::thread waiter([&] {
+    for (std::size_t i = 0u; i < samples; ++i) {
+      semaphores[i].wait();
+      woken[i] = std::chrono::steady_clock::now();
+    }
+  });
+  for (std::size_t i = 0u; i < samples; ++i) {
+    std::this_thread::sleep_for(BLOCK_DELAY);
+    released[i] = std::chrono::steady_clock::now();
+    semaphores[i].release();
+  }
+  waiter.join();
+  std::vector<double> result(samples);
+  for (std::size_t i = 0u; i < samples; ++i) {
+    result[i] = std::chrono::duration<double, std::nano>(
+        woken[i] - released[i]).count();
+  }
+  return result;
+}
+
+template <class BinarySemaphore>
+double measure_ping_pong(std::size_t rounds) {                                  /// Round trips per second between two threads
+  std::unique_ptr<BinarySemaphore[]> ping(new BinarySemaphore[rounds]),
+                                     pong(new BinarySemaphore[rounds]);
+  auto start = std::chrono::steady_clock::now();
+  std::thread other([&] {
+    for (std::size_t i = 0u; i < rounds; ++i) {
+      ping[i].wait();
+      pong[i].release();
+    }
+  });
+  for (std::size_t i = 0u; i < rounds; ++i) {
+    ping[i].release();
+    pong[i].wait();
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  other.join();
+  return rounds / elapsed.count();
+}
+
+template <class BinarySemaphore>
+double measure_cpu_burn() {                                                     /// CPU time of the waiter divided by the time it waited
+  double cpu = 0., wall = 0.;
+  for (std::size_t i = 0u; i < CPU_BURN_SAMPLES; ++i) {
+    BinarySemaphore semaphore;
+    std::thread waiter([&] {
+      double cpu_start = thread_cpu_ns();
+      auto start = std::chrono::steady_clock::now();
+      semaphore.wait();
+      cpu += thread_cpu_ns() - cpu_start;
+      wall += std::chrono::duration<double, std::nano>(
+          std::chrono::steady_clock::now() - start).count();
+    });
+    std::this_thread::sleep_for(CPU_BURN_WAIT);
+    semaphore.release();
+    waiter.join();
+  }
+  return cpu / wall;
+}
+
+class BackgroundLoad {                                                          /// Spinning threads that compete with the semaphores for the cores
+ public:
+  explicit BackgroundLoad(std::size_t count) : stop_(false) {
+    for (std::size_t i = 0u; i < count; ++i) {
+      threads_.emplace_back([this] {
+        while (!stop_.load(std::memory_order_relaxed)) {}
+      });
+    }
+  }
+
+  ~BackgroundLoad() {
+    stop_.store(true, std::memory_order_relaxed);
+    for (auto& th : threads_) {
+      th.join();
+    }
+  }
+
+ private:
+  std::atomic_bool stop_;
+  std::vector<std::thread> threads_;
+};
+
+template <class BinarySemaphore>
+void run(const char* name, std::size_t samples, std::size_t background,
+         bool& first) {
+  BackgroundLoad load(background);
+  std::vector<double> latency = measure_latency<BinarySemaphore>(samples);
+  double throughput = measure_ping_pong<BinarySemaphore>(samples);
+  double cpu_burn = measure_cpu_burn<BinarySemaphore>();
+  std::cout << (first ? "\n" : ",\n")
+            << "    {\"semaphore\": \"" << name << "\", "
+            << "\"background_threads\": " << background << ", "
+            << "\"latency_ns\": {\"p50\": " << percentile(latency, 0.5)
+            << ", \"p99\": " << percentile(latency, 0.99)
+            << ", \"p999\": " << percentile(latency, 0.999) << "}, "
+            << "\"ping_pong_round_trips_per_second\": " << throughput << ", "
+            << "\"wait_cpu_ratio\": " << cpu_burn << "}";
+  first = false;
+}
+
+int main(int argc, char** argv) {
+  std::size_t samples = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000u;  /// Usage: benchmark_4_binary_semaphore [samples]
+  std::size_t cores = std::max(1u, std::thread::hardware_concurrency());
+  bool first = true;
+  std::cout << "{\"benchmark\": \"binary_semaphore\", "
+            << "\"hardware_concurrency\": " << cores << ", "
+            << "\"samples\": " << samples << ", \"results\": [";
+  for (std::size_t background : {(std::size_t)0u, cores * 2u}) {                /// Idle, then oversubscribed
+    run<con::SpinBinarySemaphore>(
+        "SpinBinarySemaphore", samples, background, first);
+    run<con::BlockingBinarySemaphore>(
+        "BlockingBinarySemaphore", samples, background, first);
+#ifdef _POSIX_SOURCE
+    run<con::PosixBinarySemaphore>(
+        "PosixBinarySemaphore", samples, background, first);
+#endif // _POSIX_SOURCE
+#if defined(_GLIBCXX_HAVE_LINUX_FUTEX) && ATOMIC_INT_LOCK_FREE > 1
+    run<con::LinuxFutexBinarySemaphore>(
+        "LinuxFutexBinarySemaphore", samples, background, first);
+#endif // defined(_GLIBCXX_HAVE_LINUX_FUTEX) && ATOMIC_INT_LOCK_FREE > 1
+    run<con::DisposableBinarySemaphore>(
+        "DisposableBinarySemaphore", samples, background, first);
+    run<con::HelpingBinarySemaphore>(
+        "HelpingBinarySemaphore", samples, background, first);
+  }
+  std::cout << "\n  ]\n}" << std::endl;
+  return 0;
+}
@@ -0,0 +1,288 @@
+/** Copyright (C) 2015-2017 Mingxin Wang - All Rights Reserved.
+ *  This is a C++ source file, and is also a benchmark for
+ *  the Concurrent Support Library.
+ *
+ *  @file     benchmark_5_atomic_counter.cc
+ *  @author   Mingxin Wang
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif // __linux__
+
+#include "../solution/concurrent.h"
+
+constexpr std::size_t FLAT_WIDTH = 1024u;
+constexpr std::size_t FLAT_ROUNDS = 500u;
+constexpr std::size_t FIBONACCI_N = 16u;
+constexpr std::size_t FIBONACCI_ROUNDS = 200u;
+constexpr std::size_t GROW_TASKS = 4096u;
+constexpr std::size_t GROW_ROUNDS = 100u;
+
+std::atomic_size_t allocations(0u);                                             /// Counts every call to the global operator new
+
+void* allocate(std::size_t size) {
+  allocations.fetch_add(1u, std::memory_order_relaxed);
+  void* p = std::malloc(size == 0u ? 1u : size);
+  if (p == nullptr) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void* allocate(std::size_t size, std::align_val_t alignment) {
+  allocations.fetch_add(1u, std::memory_order_relaxed);
+  std::size_t a = (std::size_t)alignment;
+  void* p = std::aligned_alloc(a, (size + a - 1u) / a * a);
+  if (p == nullptr) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void* operator new(std::size_t size) { return allocate(size); }
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+  return allocate(size, alignment);
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept {
+  std::free(p);
+}
+
+class CacheMissCounter {                                                        /// Counts the cache misses of this thread and the threads created later
+ public:
+  CacheMissCounter() : fd_(-1) {
+#ifdef __linux__
+    perf_event_attr attr{};
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = PERF_COUNT_HW_CACHE_MISSES;
+    attr.inherit = 1;                                                           /// Counts of the pool threads are added when they exit
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    fd_ = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+#endif // __linux__
+  }
+
+  ~CacheMissCounter() {
+#ifdef __linux__
+    if (fd_ != -1) {
+      close(fd_);
+    }
+#endif // __linux__
+  }
+
+  bool available() const { return fd_ != -1; }
+
+  long long read_value() const {
+    long long value = 0;
+#ifdef __linux__
+    if (fd_ != -1 && read(fd_, &value, sizeof(value)) != sizeof(value)) {
+      value = 0;
+    }
+#endif // __linux__
+    return value;
+  }
+
+ private:
+  int fd_;
+};
+
+class JoinableThreadPortal {                                                    /// Starts the pool threads so that they can be joined after the pool is shut down
+ public:
+  explicit JoinableThreadPortal(std::vector<std::thread>& threads)
+      : threads_(&threads) {}
+
+  template <class F>
+  void operator()(F&& f) const {
+    threads_->emplace_back(std::forward<F>(f));
+  }
+
+ private:
+  std::vector<std::thread>* threads_;
+};
+
+class PoolPortal {                                                              /// A copyable reference to a thread pool, the modifiers are not type-erased
+ public:
+  explicit PoolPortal(const con::ThreadPoolPortal<>& pool) : pool_(&pool) {}
+
+  template <class F, class... Args>
+  void operator()(F&& f, Args&&... args) const {
+    (*pool_)(std::forward<F>(f), std::forward<Args>(args)...);
+  }
+
+ private:
+  const con::ThreadPoolPortal<>* pool_;
+};
+
+class LeafProcedure {                                                           /// Joins without doing anything
+ public:
+  template <class AtomicCounterModifier, class Callback>
+  void operator()(AtomicCounterModifier&&, Callback&&) const {}
+};
+
+class FlatProcedure {                                                           /// Forks all the leaves at once
+ public:
+  explicit FlatProcedure(const PoolPortal& portal) : portal_(portal) {}
+
+  template <class AtomicCounterModifier, class Callback>
+  void operator()(AtomicCounterModifier&& modifier, Callback&& callback) const {
+    con::concurrent_fork(
+        modifier, callback,
+        con::make_concurrent_caller(FLAT_WIDTH, con::make_concurrent_callable(
+            con::copy_construct(portal_), LeafProcedure())));
+  }
+
+ private:
+  const PoolPortal portal_;
+};
+
+class FibonacciProcedure {                                                      /// Forks fib(n - 1) and fib(n - 2), the tree has fibonacci_nodes(n) tasks
+ public:
+  explicit FibonacciProcedure(const PoolPortal& portal, std::size_t n)
+      : portal_(portal), n_(n) {}
+
+  template <class AtomicCounterModifier, class Callback>
+  void operator()(AtomicCounterModifier&& modifier, Callback&& callback) const {
+    if (n_ >= 2u) {
+      con::concurrent_fork(
+          modifier, callback,
+          con::make_concurrent_caller(con::make_concurrent_callable(
+              con::copy_construct(portal_), FibonacciProcedure(portal_, n_ - 1u))),
+          con::make_concurrent_caller(con::make_concurrent_callable(
+              con::copy_construct(portal_), FibonacciProcedure(portal_, n_ - 2u))));
+    }
+  }
+
+ private:
+  const PoolPortal portal_;
+  const std::size_t n_;
+};
+
+std::size_t fibonacci_nodes(std::size_t n) {
+  return n < 2u ? 1u : 1u + fibonacci_nodes(n - 1u) + fibonacci_nodes(n - 2u);
+}
+
+class GrowProcedure {                                                           /// Forks the tasks one at a time at runtime, as example 3 does with '+'
+ public:
+  explicit GrowProcedure(const PoolPortal& portal) : portal_(portal) {}
+
+  template <class AtomicCounterModifier, class Callback>
+  void operator()(AtomicCounterModifier&& modifier, Callback&& callback) const {
+    for (std::size_t i = 0u; i < GROW_TASKS; ++i) {
+      con::concurrent_fork(
+          modifier, callback,
+          con::make_concurrent_caller(con::make_concurrent_callable(
+              con::copy_construct(portal_), LeafProcedure())));
+    }
+  }
+
+ private:
+  const PoolPortal portal_;
+};
+
+template <class Initializer>
+std::size_t run_flat(const PoolPortal& portal) {                                /// Returns the number of joins
+  for (std::size_t i = 0u; i < FLAT_ROUNDS; ++i) {
+    con::sync_concurrent_invoke_explicit(
+        Initializer(), con::DisposableBinarySemaphore(), [] {},
+        con::make_concurrent_caller(con::make_concurrent_callable(
+            con::SerialPortal(), FlatProcedure(portal))));
+  }
+  return FLAT_ROUNDS * (FLAT_WIDTH + 1u);
+}
+
+template <class Initializer>
+std::size_t run_fibonacci(const PoolPortal& portal) {
+  for (std::size_t i = 0u; i < FIBONACCI_ROUNDS; ++i) {
+    con::sync_concurrent_invoke_explicit(
+        Initializer(), con::DisposableBinarySemaphore(), [] {},
+        con::make_concurrent_caller(con::make_concurrent_callable(
+            con::copy_construct(portal), FibonacciProcedure(portal, FIBONACCI_N))));
+  }
+  return FIBONACCI_ROUNDS * fibonacci_nodes(FIBONACCI_N);
+}
+
+template <class Initializer>
+std::size_t run_grow(const PoolPortal& portal) {
+  for (std::size_t i = 0u; i < GROW_ROUNDS; ++i) {
+    con::sync_concurrent_invoke_explicit(
+        Initializer(), con::DisposableBinarySemaphore(), [] {},
+        con::make_concurrent_caller(con::make_concurrent_callable(
+            con::SerialPortal(), GrowProcedure(portal))));
+  }
+  return GROW_ROUNDS * (GROW_TASKS + 1u);
+}
+
+template <class Initializer, class Workload>
+void run(const char* workload_name, const char* counter_name,
+         std::size_t threads, Workload workload) {
+  CacheMissCounter cache_misses;                                                /// Opened before the pool threads are started
+  std::vector<std::thread> pool_threads;
+  std::size_t joins, allocated;
+  std::chrono::duration<double> elapsed;
+  {
+    con::ThreadPoolPortal<> pool(threads, JoinableThreadPortal(pool_threads));
+    PoolPortal portal(pool);
+    workload(portal);                                                           /// Warm up
+    std::size_t allocations_before = allocations.load();
+    auto start = std::chrono::steady_clock::now();
+    joins = workload(portal);
+    elapsed = std::chrono::steady_clock::now() - start;
+    allocated = allocations.load() - allocations_before;
+  }
+  for (auto& th : pool_threads) {
+    th.join();
+  }
+  std::cout << workload_name << "\t" << counter_name << "\t" << threads
+            << " threads: " << joins / elapsed.count() << " joins/s, ";
+  if (cache_misses.available()) {
+    std::cout << (double)cache_misses.read_value() / (joins * 2u)               /// The warm up made as many joins
+              << " cache misses/join, ";
+  } else {
+    std::cout << "cache misses unavailable, ";
+  }
+  std::cout << (double)allocated / joins << " allocations/join" << std::endl;
+}
+
+template <class Initializer>
+void run_all(const char* counter_name, std::size_t threads) {
+  run<Initializer>("flat", counter_name, threads, run_flat<Initializer>);
+  run<Initializer>("fibonacci", counter_name, threads,
+                   run_fibonacci<Initializer>);
+  run<Initializer>("grow", counter_name, threads, run_grow<Initializer>);
+}
+
+int main() {
+  std::size_t cores = std::max(1u, std::thread::hardware_concurrency());
+  std::vector<std::size_t> thread_counts;
+  for (std::size_t threads = 1u; threads < cores; threads <<= 1) {
+    thread_counts.push_back(threads);
+  }
+  thread_counts.push_back(cores);
+  for (std::size_t threads : thread_counts) {
+    run_all<con::BasicAtomicCounter::Initializer>("Basic", threads);
+    run_all<con::TreeAtomicCounter<2u>::Initializer>("Tree<2>", threads);
+    run_all<con::TreeAtomicCounter<8u>::Initializer>("Tree<8>", threads);
+    run_all<con::TreeAtomicCounter<32u>::Initializer>("Tree<32>", threads);
+    run_all<con::TreeAtomicCounter<128u>::Initializer>("Tree<128>", threads);
+  }
+  return 0;
+}
@@ -0,0 +1,270 @@
+/** Copyright (C) 2015-2017 Mingxin Wang - All Rights Reserved.
+ *  This is a C++ source file, and is also a benchmark for
+ *  the Concurrent Support Library.
+ *
+ *  @file     benchmark_6_allocations.cc
+ *  @author   Mingxin Wang
+ */
+
+#define CON_LIB_ALLOCATION_ACCOUNTING
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <string>
+#include <thread>
+
+#include "../solution/concurrent.h"
+
+void* allocate(std::size_t size) {                                              /// Every allocation of the program is passed to the hook
+  con::allocation::on_allocate(size);
+  void* p = std::malloc(size == 0u ? 1u : size);
+  if (p == nullptr) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void* allocate(std::size_t size, std::align_val_t alignment) {
+  con::allocation::on_allocate(size);
+  std::size_t a = (std::size_t)alignment;
+  void* p = std::aligned_alloc(a, (size + a - 1u) / a * a);
+  if (p == nullptr) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void* operator new(std::size_t size) { return allocate(size); }
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+  return allocate(size, alignment);
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+void operator delete(void* p, std::align_val_t) noexcept { std::free(p); }
+
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept {
+  std::free(p);
+}
+
+void wait_for(const std::atomic_bool& done) {                                   /// Waits for an async invoke without allocating
+  while (!done.load(std::memory_order_acquire)) {
+    std::this_thread::yield();
+  }
+}
+
+std::atomic_size_t running(0u);                                                 /// Threads started by the examples that have not returned yet
+
+template <bool DAEMON>
+class JoinedThreadPortal {                                                      /// A ThreadPortal whose threads wait_for_threads() waits for
+ public:
+  template <class F, class... Args>
+  void operator()(F&& f, Args&&... args) const {
+    running.fetch_add(1u, std::memory_order_relaxed);
+    con::ThreadPortal<DAEMON>()(
+        [f = std::decay_t<F>(std::forward<F>(f))](
+            std::decay_t<Args>&&... args) mutable {
+          f(std::move(args)...);
+          running.fetch_sub(1u, std::memory_order_release);
+        },
+        std::forward<Args>(args)...);
+  }
+};
+
+void wait_for_threads() {                                                       /// Their allocations are all made once they have returned
+  while (running.load(std::memory_order_acquire) != 0u) {
+    std::this_thread::yield();
+  }
+}
+
+void example_1() {
+  con::sync_concurrent_invoke(
+      [] {},
+      con::make_concurrent_caller(
+          10u,
+          con::make_concurrent_callable(
+              JoinedThreadPortal<true>(),
+              con::make_concurrent_procedure([] {}))));
+}
+
+void example_2() {
+  std::atomic_bool done(false);
+  con::async_concurrent_invoke(
+      [&] { done.store(true, std::memory_order_release); },
+      con::make_concurrent_caller(
+          10u,
+          con::make_concurrent_callable(
+              JoinedThreadPortal<false>(),
+              con::make_concurrent_procedure([] {}))));
+  wait_for(done);
+}
+
+void work() {}
+
+auto make_worker_callable() {
+  return con::make_concurrent_callable(
+      JoinedThreadPortal<true>(), con::make_concurrent_procedure(work));        /// A pointer of function, as in example 3
+}
+
+class MainProcedure {                                                           /// Forks one more worker, as entering '+' in example 3
+ public:
+  template <class AtomicCounterModifier, class Callback>
+  void operator()(AtomicCounterModifier&& modifier, Callback&& callback) const {
+    con::concurrent_fork(
+        modifier, callback,
+        con::make_concurrent_caller(1u, make_worker_callable()));               /// 1D callers, for 0D ones crash GCC 12 with the other examples
+  }
+};
+
+void example_3() {
+  con::sync_concurrent_invoke(
+      [] {},
+      con::make_concurrent_caller(3u, make_worker_callable()),
+      con::make_concurrent_caller(
+          1u, con::make_concurrent_callable(con::SerialPortal(), MainProcedure())));
+}
+
+void example_4(const con::abstraction::ConcurrentCallablePortal& pool) {
+  con::ConcurrentCaller1D<con::MultiPhaseConcurrentCallable<>> caller;
+  for (int i = 1; i <= 10; ++i) {
+    con::MultiPhaseConcurrentCallable<> callable;
+    callable.append_phase(JoinedThreadPortal<true>(),
+                          con::make_concurrent_procedure([] {}));
+    callable.append_phase(pool, con::make_concurrent_procedure([] {}));
+    caller.emplace(std::move(callable));
+  }
+  con::sync_concurrent_invoke([] {}, caller);
+}
+
+void example_5() {
+  int a[10] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
+  int b[10] = {0};
+  std::size_t concurrency = std::max(1u, std::thread::hardware_concurrency());
+  auto make_callable = [&](std::size_t first, std::size_t last) {
+    return con::make_concurrent_callable(
+        JoinedThreadPortal<true>(),
+        con::make_concurrent_procedure([&a, &b, first, last] {
+          std::copy(a + first, a + last, b + first);
+        }));
+  };
+  con::ConcurrentCaller1D<decltype(make_callable(0u, 0u))> caller;
+  for (std::size_t i = 0u; i < concurrency; ++i) {
+    caller.emplace(make_callable(10u * i / concurrency,
+                                 10u * (i + 1u) / concurrency));
+  }
+  con::sync_concurrent_invoke([] {}, caller);
+}
+
+void example_6() {
+  auto pipeline = con::make_concurrent_pipeline<int>(
+      16u,
+      con::make_pipeline_stage(
+          JoinedThreadPortal<true>(), [](int x) { return x * x; }, 4u),
+      con::make_pipeline_stage(
+          JoinedThreadPortal<true>(), [](int x) { return x + 1; }, 2u, 8u),
+      con::make_pipeline_stage(JoinedThreadPortal<true>(), [](int) {}));
+  con::sync_concurrent_invoke(
+      [&] {
+        for (int i = 1; i <= 100; ++i) {
+          pipeline.push(i);
+        }
+        pipeline.close();
+      },
+      pipeline);
+}
+
+void example_7() {
+  con::sync_concurrent_invoke_gather(
+      JoinedThreadPortal<true>(), 10u, [](std::size_t i) { return i * i; });
+  con::sync_concurrent_invoke_gather(
+      JoinedThreadPortal<true>(), 5u,
+      [](std::size_t i) { return "word" + std::to_string(i); },
+      [](std::string lhs, std::string rhs) { return lhs + " " + rhs; });
+}
+
+void example_8(con::ConcurrentGraph<>& graph) {
+  con::sync_concurrent_invoke([] {}, graph);
+}
+
+void example_9(const con::abstraction::ConcurrentCallablePortal& pool) {
+  con::EventLoopPortal<> loop;
+  auto make_caller = [&] {
+    return con::make_concurrent_caller(
+        4u,
+        con::make_concurrent_callable(
+            con::copy_construct(pool),
+            con::make_concurrent_procedure([] {})));
+  };
+  con::async_concurrent_invoke_on(
+      loop,
+      [&] {
+        con::async_concurrent_invoke_on(
+            loop, [&] { loop.stop(); }, make_caller());
+      },
+      make_caller());
+  loop.run();
+}
+
+template <class F>
+bool run(const char* name, std::size_t rounds, double budget, bool& first,
+         F example) {                                                           /// Returns whether the library stays within the budget
+  example();                                                                    /// Warm up, so that the static objects are not counted
+  wait_for_threads();
+  con::allocation::Report before = con::allocation::report();
+  for (std::size_t i = 0u; i < rounds; ++i) {
+    example();
+  }
+  wait_for_threads();
+  con::allocation::Report after = con::allocation::report();
+  double library = 0.;
+  std::cout << (first ? "\n" : ",\n") << "    {\"example\": \"" << name
+            << "\", \"allocations_per_invoke\": {";
+  for (std::size_t i = 0u; i < con::allocation::COMPONENT_COUNT; ++i) {
+    double count = (double)(after[i].count_ - before[i].count_) / rounds;
+    if (i != (std::size_t)con::allocation::Component::USER) {
+      library += count;
+    }
+    std::cout << (i == 0u ? "" : ", ") << "\""
+              << con::allocation::component_name(
+                     (con::allocation::Component)i)
+              << "\": " << count;
+  }
+  std::cout << "}, \"library_allocations_per_invoke\": " << library << "}";
+  first = false;
+  return budget < 0. || library <= budget;
+}
+
+int main(int argc, char** argv) {
+  std::size_t rounds = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 100u;   /// Usage: benchmark_6_allocations [rounds] [budget]
+  double budget = argc > 2 ? std::strtod(argv[2], nullptr) : -1.;               /// Library allocations allowed per invoke, unlimited by default
+  con::abstraction::ConcurrentCallablePortal pool(con::ThreadPoolPortal<>(2u));
+  con::ConcurrentGraph<> graph;
+  std::size_t nodes[4];
+  for (std::size_t& node : nodes) {
+    node = graph.add_node(pool, con::make_concurrent_procedure([] {}));
+  }
+  graph.add_edge(nodes[0], nodes[1]);                                           /// The diamond of example 8
+  graph.add_edge(nodes[0], nodes[2]);
+  graph.add_edge(nodes[1], nodes[3]);
+  graph.add_edge(nodes[2], nodes[3]);
+  bool first = true, ok = true;
+  std::cout << "{\"benchmark\": \"allocations\", \"rounds\": " << rounds
+            << ", \"results\": [";
+  ok &= run("example_1", rounds, budget, first, example_1);
+  ok &= run("example_2", rounds, budget, first, example_2);
+  ok &= run("example_3", rounds, budget, first, example_3);
+  ok &= run("example_4", rounds, budget, first, [&] { example_4(pool); });
+  ok &= run("example_5", rounds, budget, first, example_5);
+  ok &= run("example_6", rounds, budget, first, example_6);
+  ok &= run("example_7", rounds, budget, first, example_7);
+  ok &= run("example_8", rounds, budget, first, [&] { example_8(graph); });
+  ok &= run("example_9", rounds, budget, first, [&] { example_9(pool); });
+  std::cout << "\n  ]\n}" << std::endl;
+  return ok ? 0 : 1;                                                            /// Fails when any example exceeds the budget
+}
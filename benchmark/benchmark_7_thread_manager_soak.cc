@@ -0,0 +1,60 @@
+/** Copyright (C) 2015-2017 Mingxin Wang - All Rights Reserved.
+ *  This is a C++ source file, and is also a benchmark for
+ *  the Concurrent Support Library.
+ *
+ *  @file     benchmark_7_thread_manager_soak.cc
+ *  @author   Mingxin Wang
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <thread>
+
+#include <unistd.h>
+
+#include "../solution/concurrent.h"
+
+std::size_t resident_kb() {                                                     /// Reads the resident set size of this process
+  std::ifstream statm("/proc/self/statm");
+  std::size_t size = 0u, resident = 0u;
+  statm >> size >> resident;
+  return resident * (std::size_t)sysconf(_SC_PAGESIZE) / 1024u;
+}
+
+int main(int argc, char** argv) {
+  std::size_t submissions =
+      argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000u;                 /// Usage: benchmark_7_thread_manager_soak [submissions] [batch]
+  std::size_t batch = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 1000u;
+  std::size_t report_every = std::max<std::size_t>(submissions / 20u, batch);
+  std::atomic_size_t finished(0u);
+  std::size_t peak = 0u;
+  bool first = true;
+  std::cout << "{\"benchmark\": \"thread_manager_soak\", \"submissions\": "
+            << submissions << ", \"samples\": [";
+  for (std::size_t submitted = 0u; submitted < submissions;) {
+    std::size_t n = std::min(batch, submissions - submitted);
+    for (std::size_t i = 0u; i < n; ++i) {
+      con::ThreadPortal<false>()([&] {
+        finished.fetch_add(1u, std::memory_order_relaxed);
+      });
+    }
+    submitted += n;
+    while (finished.load(std::memory_order_relaxed) < submitted) {              /// Bounds the live threads to one batch
+      std::this_thread::yield();
+    }
+    std::size_t registered = con::ThreadManager::instance().size();
+    peak = std::max(peak, registered);
+    if (submitted % report_every < n || submitted == submissions) {
+      std::cout << (first ? "\n" : ",\n") << "    {\"submitted\": " << submitted
+                << ", \"rss_kb\": " << resident_kb()
+                << ", \"registered_threads\": " << registered << "}";
+      first = false;
+    }
+  }
+  std::cout << "\n  ], \"peak_registered_threads\": " << peak << "}"
+            << std::endl;                                                       /// Stays bounded, while it grew with the submissions before
+  return 0;
+}
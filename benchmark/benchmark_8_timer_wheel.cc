@@ -0,0 +1,136 @@
+/** Copyright (C) 2015-2017 Mingxin Wang - All Rights Reserved.
+ *  This is a C++ source file, and is also a benchmark for
+ *  the Concurrent Support Library.
+ *
+ *  @file     benchmark_8_timer_wheel.cc
+ *  @author   Mingxin Wang
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+#include "../solution/concurrent.h"
+
+using Clock = std::chrono::steady_clock;
+
+std::size_t resident_kb() {
+  std::ifstream statm("/proc/self/statm");
+  std::size_t size = 0u, resident = 0u;
+  statm >> size >> resident;
+  return resident * (std::size_t)sysconf(_SC_PAGESIZE) / 1024u;
+}
+
+double elapsed_ns(Clock::time_point start) {
+  return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(
+      Clock::now() - start).count();
+}
+
+class Probe {                                                                   /// Records how late a timer fires, and whether it fires early
+ public:
+  Probe(Clock::time_point deadline, con::AtomicHistogram& lateness,
+        std::atomic_size_t& fired, std::atomic_size_t& early)
+      : deadline_(deadline), lateness_(&lateness), fired_(&fired),
+        early_(&early) {}
+
+  void operator()() const {
+    Clock::time_point now = Clock::now();
+    if (now < deadline_) {
+      early_->fetch_add(1u, std::memory_order_relaxed);
+    } else {
+      lateness_->record((std::uint64_t)std::chrono::duration_cast<
+          std::chrono::microseconds>(now - deadline_).count());
+    }
+    fired_->fetch_add(1u, std::memory_order_relaxed);
+  }
+
+ private:
+  Clock::time_point deadline_;
+  con::AtomicHistogram* lateness_;
+  std::atomic_size_t* fired_;
+  std::atomic_size_t* early_;
+};
+
+bool run_accuracy(const char* name, std::chrono::nanoseconds resolution,
+                  std::size_t timers, std::chrono::microseconds max_delay) {    /// Returns whether every timer fires, and none fires early
+  con::AtomicHistogram lateness;
+  std::atomic_size_t fired(0u), early(0u);
+  std::mt19937 random(7u);
+  std::uniform_int_distribution<long long> delays(0, max_delay.count());
+  {
+    con::DelayPortal<con::SerialPortal> portal(
+        std::chrono::nanoseconds(0), con::SerialPortal(), resolution);
+    for (std::size_t i = 0u; i < timers; ++i) {
+      std::chrono::microseconds delay(delays(random));
+      portal.schedule_after(
+          delay, Probe(Clock::now() + delay, lateness, fired, early));
+    }
+    while (fired.load() < timers) {                                             /// The portal is kept, for the pending timers fire at once when the last one is destroyed
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+  }
+  con::Histogram result = lateness.load();
+  std::cout << "    {\"workload\": \"" << name << "\", \"timers\": " << timers
+            << ", \"early\": " << early.load()
+            << ", \"lateness_us\": {\"mean\": " << result.mean()
+            << ", \"p50\": " << result.quantile(.5)
+            << ", \"p99\": " << result.quantile(.99) << "}}";
+  return early.load() == 0u;
+}
+
+int main(int argc, char** argv) {
+  std::size_t pending =
+      argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000u;                 /// Usage: benchmark_8_timer_wheel [pending]
+  bool ok = true;
+  std::cout << "{\"benchmark\": \"timer_wheel\", \"results\": [\n";
+  {
+    std::atomic_size_t fired(0u);
+    con::DelayPortal<con::SerialPortal> portal(std::chrono::hours(1),
+                                               con::SerialPortal());
+    std::mt19937 random(7u);
+    std::uniform_int_distribution<long long> delays(1, 3600);
+    std::vector<con::TimerHandle> handles;
+    handles.reserve(pending);
+    std::size_t rss_before = resident_kb();
+    Clock::time_point start = Clock::now();
+    for (std::size_t i = 0u; i < pending; ++i) {
+      handles.push_back(portal.schedule_after(
+          std::chrono::seconds(delays(random)),
+          [&fired] { fired.fetch_add(1u, std::memory_order_relaxed); }));
+    }
+    double insert_ns = elapsed_ns(start) / pending;
+    std::size_t rss_after = resident_kb();
+    std::shuffle(handles.begin(), handles.end(), random);
+    start = Clock::now();
+    std::size_t cancelled = 0u;
+    for (const con::TimerHandle& handle : handles) {
+      cancelled += portal.cancel(handle) ? 1u : 0u;
+    }
+    double cancel_ns = elapsed_ns(start) / pending;
+    std::size_t stale = 0u;
+    for (std::size_t i = 0u; i < 1000u && i < handles.size(); ++i) {            /// Handles of the cancelled timers no longer match
+      stale += portal.cancel(handles[i]) ? 1u : 0u;
+    }
+    ok &= cancelled == pending && stale == 0u && fired.load() == 0u;
+    std::cout << "    {\"workload\": \"pending\", \"timers\": " << pending
+              << ", \"insert_ns\": " << insert_ns
+              << ", \"cancel_ns\": " << cancel_ns
+              << ", \"rss_kb_per_1k_timers\": "
+              << (double)(rss_after - rss_before) * 1000. / pending << "},\n";
+  }
+  ok &= run_accuracy("millisecond", std::chrono::milliseconds(1), 10000u,
+                     std::chrono::milliseconds(200));
+  std::cout << ",\n";
+  ok &= run_accuracy("cascade", std::chrono::microseconds(1), 1000u,
+                     std::chrono::milliseconds(600));                           /// Fine ticks, so that the timers are cascaded down the levels
+  std::cout << "\n  ]\n}" << std::endl;
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,128 @@
+/** Copyright (C) 2015-2017 Mingxin Wang - All Rights Reserved.
+ *  This is a C++ source file, and is also a benchmark for
+ *  the Concurrent Support Library.
+ *
+ *  @file     benchmark_9_async_io.cc
+ *  @author   Mingxin Wang
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "../solution/concurrent.h"
+
+using Clock = std::chrono::steady_clock;
+
+class Transferred {                                                             /// Counts the bytes of the completions, and the failed ones
+ public:
+  Transferred(std::atomic<std::int64_t>& bytes, std::atomic_size_t& errors)
+      : bytes_(&bytes), errors_(&errors) {}
+
+  void operator()(std::int64_t result) const {
+    if (result < 0) {
+      errors_->fetch_add(1u, std::memory_order_relaxed);
+    } else {
+      bytes_->fetch_add(result, std::memory_order_relaxed);
+    }
+  }
+
+ private:
+  std::atomic<std::int64_t>* bytes_;
+  std::atomic_size_t* errors_;
+};
+
+template <class MakeProcedure>
+double run_phase(std::size_t blocks, std::size_t block_size,
+                 MakeProcedure make_procedure) {                                /// Returns MB/s, every block is an asynchronous I/O joined by its completion
+  auto make_callable = [&](std::size_t i) {
+    return con::make_concurrent_callable(con::SerialPortal(),                   /// The I/O is only submitted on the calling thread
+                                         make_procedure(i));
+  };
+  con::ConcurrentCaller1D<decltype(make_callable(0u))> caller;
+  for (std::size_t i = 0u; i < blocks; ++i) {
+    caller.emplace(make_callable(i));
+  }
+  Clock::time_point start = Clock::now();
+  con::sync_concurrent_invoke([] {}, caller);
+  std::chrono::duration<double> elapsed = Clock::now() - start;
+  return (double)blocks * block_size / (1024. * 1024.) / elapsed.count();
+}
+
+int make_file(std::size_t size) {                                               /// A temporary file of the given size, removed when the descriptor is closed
+  const char* directory = std::getenv("TMPDIR");
+  std::string path = std::string(directory == nullptr ? "/tmp" : directory)
+      + "/benchmark_9_async_io_XXXXXX";
+  int fd = mkstemp(&path[0]);
+  if (fd != -1) {
+    unlink(path.c_str());
+    if (posix_fallocate(fd, 0, (off_t)size) != 0) {                             /// Allocated up front, so that no write extends the file
+      close(fd);
+      fd = -1;
+    }
+  }
+  return fd;
+}
+
+bool run(const char* name, const con::AsyncFileIo& io, std::size_t blocks,
+         std::size_t block_size, bool& first) {                                 /// Returns whether every byte is transferred
+  int fd = make_file(blocks * block_size);
+  if (fd == -1) {
+    return false;
+  }
+  std::vector<char> source(block_size, 'x'), target(blocks * block_size);
+  std::atomic<std::int64_t> written(0), read(0);
+  std::atomic_size_t errors(0u);
+  auto write_procedure = [&](std::size_t i) {
+    return con::make_async_write_procedure(
+        io, fd, source.data(), block_size, (std::uint64_t)i * block_size,
+        Transferred(written, errors));
+  };
+  run_phase(blocks, block_size, write_procedure);                               /// Warm up, so that both backends overwrite cached pages
+  written = 0;
+  double write_rate = run_phase(blocks, block_size, write_procedure);
+  double read_rate = run_phase(blocks, block_size, [&](std::size_t i) {
+    return con::make_async_read_procedure(
+        io, fd, target.data() + i * block_size, block_size,
+        (std::uint64_t)i * block_size, Transferred(read, errors));
+  });
+  close(fd);
+  std::int64_t expected = (std::int64_t)(blocks * block_size);
+  bool ok = written.load() == expected && read.load() == expected &&
+      errors.load() == 0u && target == std::vector<char>(target.size(), 'x');
+  std::cout << (first ? "\n" : ",\n") << "    {\"backend\": \"" << name
+            << "\", \"write_backend\": \"thread_pool\""                         /// AsyncFileIo writes a regular file on the pool whatever the backend
+            << ", \"write_mb_s\": " << write_rate
+            << ", \"read_mb_s\": " << read_rate << ", \"errors\": "
+            << errors.load() << ", \"verified\": " << (ok ? "true" : "false")
+            << "}";
+  first = false;
+  return ok;
+}
+
+int main(int argc, char** argv) {
+  std::size_t file_mb = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 128u;   /// Usage: benchmark_9_async_io [file_mb] [block_kb]
+  std::size_t block_kb = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 128u;
+  std::size_t block_size = block_kb * 1024u;
+  std::size_t blocks = file_mb * 1024u / block_kb;
+  bool ok = true, first = true;
+  std::cout << "{\"benchmark\": \"async_io\", \"file_mb\": " << file_mb
+            << ", \"block_kb\": " << block_kb << ", \"results\": [";
+  {
+    con::AsyncFileIo io;                                                        /// Reads through io_uring when available, the writes to a file go to the pool
+    ok &= run(io.uses_io_uring() ? "io_uring" : "thread_pool", io, blocks,
+              block_size, first);
+  }
+  {
+    con::AsyncFileIo io(256u, std::thread::hardware_concurrency(), false);      /// Forces the fallback, as blocking procedures on a pool would do
+    ok &= run("thread_pool", io, blocks, block_size, first);
+  }
+  std::cout << "\n  ]\n}" << std::endl;
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,77 @@
+/** Copyright (C) 2015-2017 Mingxin Wang - All Rights Reserved.
+ *  This is a C++ source file, and is also an example for using
+ *  the Concurrent Support Library.
+ *
+ *  @file     example_10_readiness_portal.cc
+ *  @author   Mingxin Wang
+ */
+
+#include <iostream>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "../solution/concurrent.h"
+
+std::string read_available(int fd) {                                            /// Reads without blocking, the portal ensures that there is something to read
+  std::string result;
+  char buffer[256];
+  ssize_t n;
+  while ((n = read(fd, buffer, sizeof(buffer))) > 0) {
+    result.append(buffer, (std::size_t)n);
+  }
+  return result;
+}
+
+int main() {
+  int pipe_fds[2], socket_fds[2];
+  if (pipe(pipe_fds) == -1 ||
+      socketpair(AF_UNIX, SOCK_STREAM, 0, socket_fds) == -1) {
+    return 1;
+  }
+  fcntl(pipe_fds[0], F_SETFL, O_NONBLOCK);
+  fcntl(socket_fds[0], F_SETFL, O_NONBLOCK);
+  con::abstraction::ConcurrentCallablePortal                                    /// Only one worker, which is never blocked by the I/O
+      thread_pool_portal(con::ThreadPoolPortal<>(1u));
+  {
+    con::ReadinessPortal<> pipe_portal(                                         /// Starts a reactor thread
+        pipe_fds[0], EPOLLIN, thread_pool_portal);
+    con::ReadinessPortal<> socket_portal(                                       /// Shares the reactor thread of pipe_portal
+        pipe_portal, socket_fds[0], EPOLLIN, thread_pool_portal);
+    auto make_callable = [](const con::ReadinessPortal<>& portal,
+                            const char* name) {
+      int fd = portal.fd();
+      return con::make_concurrent_callable(
+          portal,                                                               /// The procedure is submitted to the pool once the fd is readable
+          con::make_concurrent_procedure([fd, name] {
+            std::cout << "Received from the " << name << ": "
+                      << read_available(fd) << std::endl;
+          }));
+    };
+    std::thread writer([&] {                                                    /// Plays the peers, which answer slowly
+      std::this_thread::sleep_for(std::chrono::milliseconds(500));
+      if (write(socket_fds[1], "pong", 4u) == -1) {}
+      std::this_thread::sleep_for(std::chrono::milliseconds(500));
+      if (write(pipe_fds[1], "hello", 5u) == -1) {}
+    });
+    con::sync_concurrent_invoke(
+        [] {},
+        con::make_concurrent_caller(1u, make_callable(pipe_portal, "pipe")),
+        con::make_concurrent_caller(1u, make_callable(socket_portal, "socket")),
+        con::make_concurrent_caller(                                            /// Runs on the same worker while the others are waiting
+            1u,
+            con::make_concurrent_callable(
+                thread_pool_portal,
+                con::make_concurrent_procedure([] {
+                  std::cout << "The worker is free while waiting." << std::endl;
+                }))));
+    writer.join();
+  }
+  for (int fd : {pipe_fds[0], pipe_fds[1], socket_fds[0], socket_fds[1]}) {
+    close(fd);
+  }
+  std::cout << "Done." << std::endl;
+  return 0;
+}
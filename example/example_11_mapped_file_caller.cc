@@ -0,0 +1,69 @@
+/** Copyright (C) 2015-2017 Mingxin Wang - All Rights Reserved.
+ *  This is a C++ source file, and is also an example for using
+ *  the Concurrent Support Library.
+ *
+ *  @file     example_11_mapped_file_caller.cc
+ *  @author   Mingxin Wang
+ */
+
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <string_view>
+
+#include "../solution/concurrent.h"
+
+std::size_t count_errors(std::string_view text) {                               /// Counts the lines that contain "ERROR"
+  std::size_t result = 0u;
+  while (!text.empty()) {
+    std::size_t end = text.find('\n');
+    std::string_view line = text.substr(0u, end);
+    if (line.find("ERROR") != std::string_view::npos) {
+      ++result;
+    }
+    text.remove_prefix(end == std::string_view::npos ? text.size() : end + 1u);
+  }
+  return result;
+}
+
+int main() {
+  std::string path = "example_11.log";
+  {
+    std::ofstream log(path);                                                    /// Write a log of a few megabytes
+    for (int i = 0; i < 100000; ++i) {
+      log << "2017-01-01 00:00:00 " << (i % 7 == 0 ? "ERROR" : "INFO")
+          << " request " << i << " finished" << std::endl;
+    }
+  }
+  std::atomic_size_t errors(0u);
+  {
+    con::MappedFile file(path);                                                 /// Map the whole file without reading it
+    con::abstraction::ConcurrentCallablePortal                                  /// Construct a con::ThreadPoolPortal and wrap it into an abstraction
+        thread_pool_portal(con::ThreadPoolPortal<>(4u));
+    con::sync_concurrent_invoke(                                                /// The "Sync Concurrent Invoke" model
+        [] {},
+        con::make_mapped_file_caller(
+            file, thread_pool_portal,
+            [&](std::string_view chunk) {                                       /// Each chunk is a view of whole lines in the mapping
+              errors.fetch_add(count_errors(chunk), std::memory_order_relaxed);
+            },
+            16u));                                                              /// Split into 16 chunks
+    std::cout << "Serial count: " << count_errors(file.view()) << std::endl;
+  }
+  std::cout << "Concurrent count: " << errors.load() << std::endl;
+  std::ofstream(path, std::ios::trunc).close();                                 /// An empty file makes a single empty chunk
+  {
+    con::MappedFile file(path);
+    std::atomic_size_t chunks(0u);
+    con::sync_concurrent_invoke(
+        [] {},
+        con::make_mapped_file_caller(
+            file, con::SerialPortal(),
+            [&](std::string_view) { chunks.fetch_add(1u); }, 16u));             /// Returns without calling f
+    std::cout << "Chunks of an empty file: " << chunks.load() << std::endl;
+  }
+  std::remove(path.c_str());
+  return 0;
+}
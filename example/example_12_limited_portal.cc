@@ -0,0 +1,62 @@
+/** Copyright (C) 2015-2017 Mingxin Wang - All Rights Reserved.
+ *  This is a C++ source file, and is also an example for using
+ *  the Concurrent Support Library.
+ *
+ *  @file     example_12_limited_portal.cc
+ *  @author   Mingxin Wang
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+#include "../solution/concurrent.h"
+
+std::atomic_size_t running(0u), peak(0u);
+
+void work() {                                                                   /// Records how many tasks run at the same time
+  std::size_t now = running.fetch_add(1u) + 1u, last = peak.load();
+  while (last < now && !peak.compare_exchange_weak(last, now)) {}
+  std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  running.fetch_sub(1u);
+}
+
+int main() {
+  con::ConcurrencyBudget budget(8u);                                            /// At most 8 tasks in flight across every portal sharing the budget
+  con::abstraction::ConcurrentCallablePortal limited_portal(
+      con::make_limited_portal(
+          con::abstraction::ConcurrentCallablePortal(con::ThreadPortal<true>()),
+          budget));
+  std::atomic_size_t splits(0u);
+  con::sync_concurrent_invoke(                                                  /// The "Sync Concurrent Invoke" model
+      [] {},
+      con::make_concurrent_caller(
+          4u,                                                                   /// 4 outer tasks, each nesting another caller
+          con::make_concurrent_callable(
+              limited_portal,
+              con::make_concurrent_procedure([&] {
+                std::size_t split = con::available_concurrency(16u);            /// At most 16, but no more than what is left of the current budget
+                splits.fetch_add(split);
+                con::ConcurrentCaller2D<> caller(limited_portal, split);        /// The default split is also limited by the current budget
+                for (int i = 0; i < 16; ++i) {
+                  caller.emplace(con::make_concurrent_callable(
+                      con::SerialPortal(),
+                      con::make_concurrent_procedure(work)));
+                }
+                con::sync_concurrent_invoke([] {}, caller);                     /// Waiting while holding a permit does not starve the nested tasks
+              }))));
+  con::BlockingBinarySemaphore semaphore;
+  auto task = [&] {
+    work();
+    semaphore.release();
+  };
+  auto portal = con::make_limited_portal(con::ThreadPortal<true>(), budget);
+  portal(task);                                                                 /// A limited portal also takes a callable by reference, and copies it
+  semaphore.wait();
+  std::cout << "Budget capacity: " << budget.capacity() << std::endl;
+  std::cout << "Peak running tasks: " << peak.load() << std::endl;
+  std::cout << "Average nested split: " << splits.load() / 4. << std::endl;
+  return 0;
+}
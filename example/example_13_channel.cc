@@ -0,0 +1,43 @@
+/** Copyright (C) 2015-2017 Mingxin Wang - All Rights Reserved.
+ *  This is a C++ source file, and is also an example for using
+ *  the Concurrent Support Library.
+ *
+ *  @file     example_13_channel.cc
+ *  @author   Mingxin Wang
+ */
+
+#include <atomic>
+#include <iostream>
+#include <numeric>
+#include <vector>
+
+#include "../solution/concurrent.h"
+
+int main() {
+  con::Channel<int> channel(8u);                                                /// A bounded channel for any number of senders and receivers
+  std::atomic_long sum(0), received(0);
+  con::abstraction::ConcurrentCallablePortal                                    /// Construct a con::ThreadPoolPortal and wrap it into an abstraction
+      thread_pool_portal(con::ThreadPoolPortal<>(5u));                          /// One worker for each producer and consumer, for they wait for each other
+  auto producers = con::make_concurrent_caller(
+      3u,                                                                       /// 3 producers send 1, 2, ..., 100 each
+      con::make_concurrent_callable(
+          thread_pool_portal,
+          con::make_concurrent_procedure([&] {
+            std::vector<int> values(100);
+            std::iota(values.begin(), values.end(), 1);
+            channel.send_batch(values.begin(), values.end());                   /// Blocks while the channel is full
+          })));
+  auto consumers = con::make_concurrent_caller(
+      2u,                                                                       /// 2 consumers receive until the channel is closed and drained
+      con::make_concurrent_callable(
+          thread_pool_portal,                                                   /// The same pool as the producers
+          con::make_channel_receive_procedure(channel, [&](int value) {
+            sum += value;
+            ++received;
+          })));
+  con::async_concurrent_invoke([&] { channel.close(); }, producers);            /// Close the channel when the last producer joins
+  con::sync_concurrent_invoke([] {}, consumers);                                /// Returns once every value is received
+  std::cout << "Received " << received.load() << " values, sum "
+            << sum.load() << " (expected " << 3 * 5050 << ")" << std::endl;
+  return 0;
+}
@@ -0,0 +1,31 @@
+/** Copyright (C) 2015-2017 Mingxin Wang - All Rights Reserved.
+ *  This is a C++ source file, and is also an example for using
+ *  the Concurrent Support Library.
+ *
+ *  @file     example_14_trace.cc
+ *  @author   Mingxin Wang
+ */
+
+#define CON_LIB_TRACE                                                           /// Compile the tracing in, before the library is included
+
+#include <fstream>
+#include <iostream>
+
+#include "../solution/concurrent.h"
+
+int main() {
+  for (int round = 0; round < 20; ++round) {                                    /// Every task runs on a new thread, which hands its buffer back when it exits
+    con::sync_concurrent_invoke(
+        [] {},
+        con::make_concurrent_caller(
+            8u,
+            con::make_concurrent_callable(
+                con::ThreadPortal<true>(),
+                con::make_concurrent_procedure([] {}))));
+  }
+  std::ofstream out("trace.json");                                              /// Open it with chrome://tracing or Perfetto
+  con::trace::dump(out);                                                        /// Shall be called when the traced tasks are quiescent
+  std::cout << "Traced 160 tasks with " << con::trace::buffer_count()
+            << " thread buffers into trace.json." << std::endl;
+  return 0;
+}
@@ -9,7 +9,6 @@
 #include <atomic>
 #include <iostream>
 #include <random>
-#include <limits>
 
 #include "../solution/concurrent.h"
 
@@ -43,7 +42,7 @@ bool check() {
 void work() {                                                                   /// The entry for the workers
   std::size_t id = worker_id.fetch_add(1u, std::memory_order_relaxed);          /// Get an id
   std::cout << "Worker " << id << " is started." << std::endl;
-  while (check()) {
+  while (!con::is_cancelled() && check()) {                                     /// Stops as soon as the invocation is cancelled
     std::cout << "Worker " << id << " is working." << std::endl;
     do_something();                                                             /// Do something non-trivial
   }
@@ -67,8 +66,7 @@ class MainProcedure : public con::ConcurrentProcedureTemplate {
       } else if (instruction == "-") {                                          /// Stop one worker (suppose there is at least one)
         exit_count.fetch_add(1u, std::memory_order_relaxed);
       } else if (instruction == "x") {                                          /// Stop all workers
-        exit_count.store(std::numeric_limits<std::size_t>::max(),
-                         std::memory_order_relaxed);
+        con::current_cancellation_token().cancel();                             /// Cancel every task that inherited the token
         break;
       }
     }
@@ -82,6 +80,8 @@ int main() {
   std::cout << "  enter '-' to remove a worker," << std::endl;
   std::cout << "  enter 'x' to remove all the workers." << std::endl;
   std::cout << std::endl;
+  con::CancellationToken token;                                                 /// The token is shared by the whole fork tree
+  con::CancellationScope scope(token);                                          /// The tasks submitted in this scope inherit the token
   con::sync_concurrent_invoke(                                                  /// The "Sync Concurrent Invoke" model
       [] {},
       con::make_concurrent_caller(INIT_COUNT, make_callable()),                 /// Make a initial concurrent caller
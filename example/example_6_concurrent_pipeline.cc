@@ -0,0 +1,38 @@
+/** Copyright (C) 2015-2017 Mingxin Wang - All Rights Reserved.
+ *  This is a C++ source file, and is also an example for using
+ *  the Concurrent Support Library.
+ *
+ *  @file     example_6_concurrent_pipeline.cc
+ *  @author   Mingxin Wang
+ */
+
+#include <iostream>
+#include <string>
+
+#include "../solution/concurrent.h"
+
+int main() {
+  auto pipeline = con::make_concurrent_pipeline<int>(                           /// Items flow through bounded queues with 16 slots
+      16u,
+      con::make_pipeline_stage(                                                 /// The first stage squares the items with 4 concurrent workers
+          con::ThreadPortal<true>(),
+          [](int x) { return x * x; },
+          4u),
+      con::make_pipeline_stage(                                                 /// The second stage formats the items, claiming 8 items at a time
+          con::ThreadPortal<true>(),
+          [](int x) { return "Item " + std::to_string(x); },
+          2u, 8u),
+      con::make_pipeline_stage(                                                 /// The last stage prints the items serially with 1 worker
+          con::ThreadPortal<true>(),
+          [](const std::string& s) { std::cout << s << std::endl; }));
+  con::sync_concurrent_invoke(                                                  /// The "Sync Concurrent Invoke" model
+      [&] {                                                                     /// Main thread feeds the pipeline while the stages are running
+        for (int i = 1; i <= 100; ++i) {
+          pipeline.push(i);                                                     /// Blocks while the first queue is full
+        }
+        pipeline.close();                                                       /// No more items, the stages exit once drained
+      },
+      pipeline);
+  std::cout << "Done." << std::endl;
+  return 0;
+}
@@ -0,0 +1,30 @@
+/** Copyright (C) 2015-2017 Mingxin Wang - All Rights Reserved.
+ *  This is a C++ source file, and is also an example for using
+ *  the Concurrent Support Library.
+ *
+ *  @file     example_7_sync_concurrent_invoke_gather.cc
+ *  @author   Mingxin Wang
+ */
+
+#include <iostream>
+#include <string>
+
+#include "../solution/concurrent.h"
+
+int main() {
+  auto squares = con::sync_concurrent_invoke_gather(                            /// Each task returns a value into its own slot
+      con::ThreadPortal<true>(),                                                /// Specifies the method to submit tasks (with daemon threads)
+      10u,                                                                      /// Specifies the number of tasks
+      [](std::size_t i) { return i * i; });                                     /// The i-th task returns "i * i"
+  for (std::size_t i = 0u; i < squares.size(); ++i) {
+    std::cout << "Task " << i << " returned " << squares[i] << std::endl;
+  }
+  std::string sentence = con::sync_concurrent_invoke_gather(                    /// The slots are combined when the last task joins
+      con::ThreadPortal<true>(),
+      5u,
+      [](std::size_t i) { return "word" + std::to_string(i); },
+      [](std::string lhs, std::string rhs) { return lhs + " " + rhs; });        /// Associative, the order of the tasks is kept
+  std::cout << sentence << std::endl;
+  std::cout << "Done." << std::endl;
+  return 0;
+}
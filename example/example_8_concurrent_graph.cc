@@ -0,0 +1,37 @@
+/** Copyright (C) 2015-2017 Mingxin Wang - All Rights Reserved.
+ *  This is a C++ source file, and is also an example for using
+ *  the Concurrent Support Library.
+ *
+ *  @file     example_8_concurrent_graph.cc
+ *  @author   Mingxin Wang
+ */
+
+#include <iostream>
+#include <string>
+
+#include "../solution/concurrent.h"
+
+int main() {
+  con::abstraction::ConcurrentCallablePortal                                    /// Construct a con::ThreadPoolPortal and wrap it into an abstraction
+      thread_pool_portal(con::ThreadPoolPortal<>(2u));
+  con::ConcurrentGraph<> graph;                                                 /// Nodes use the abstract portals and procedures by default
+  auto make_node = [&](const std::string& name) {
+    return graph.add_node(
+        thread_pool_portal,                                                     /// Copy construct
+        con::make_concurrent_procedure([name] {
+          std::cout << "Node " << name << " executed." << std::endl;
+        }));
+  };
+  std::size_t load = make_node("load"), parse = make_node("parse"),
+              index = make_node("index"), report = make_node("report");
+  graph.add_edge(load, parse);                                                  /// "parse" and "index" both wait for "load"
+  graph.add_edge(load, index);
+  graph.add_edge(parse, report);                                                /// "report" waits for both "parse" and "index"
+  graph.add_edge(index, report);
+  for (int i = 1; i <= 3; ++i) {                                                /// A graph can be invoked repeatedly
+    con::sync_concurrent_invoke([] {}, graph);                                  /// The "Sync Concurrent Invoke" model
+    std::cout << "Round " << i << " finished." << std::endl;
+  }
+  std::cout << "Done." << std::endl;
+  return 0;
+}
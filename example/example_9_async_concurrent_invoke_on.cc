@@ -0,0 +1,42 @@
+/** Copyright (C) 2015-2017 Mingxin Wang - All Rights Reserved.
+ *  This is a C++ source file, and is also an example for using
+ *  the Concurrent Support Library.
+ *
+ *  @file     example_9_async_concurrent_invoke_on.cc
+ *  @author   Mingxin Wang
+ */
+
+#include <iostream>
+
+#include "../solution/concurrent.h"
+
+int main() {
+  con::EventLoopPortal<> loop;                                                  /// The tasks submitted to the loop run on the main thread
+  con::abstraction::ConcurrentCallablePortal                                    /// Construct a con::ThreadPoolPortal and wrap it into an abstraction
+      thread_pool_portal(con::ThreadPoolPortal<>(4u));
+  auto make_caller = [&](int phase) {
+    return con::make_concurrent_caller(                                         /// Make a temporary concurrent caller
+        4u,                                                                     /// Specifies the number of tasks
+        con::make_concurrent_callable(
+            thread_pool_portal,
+            con::make_concurrent_procedure([phase] {
+              std::cout << "Phase " << phase << " task finished." << std::endl;
+            })));
+  };
+  con::async_concurrent_invoke_on(                                              /// The callback is submitted to the loop instead of running on the pool
+      loop,
+      [&] {
+        std::cout << "Phase 1 finished." << std::endl;
+        con::async_concurrent_invoke_on(                                        /// Chain the next invoke without blocking any thread
+            loop,
+            [&] {
+              std::cout << "Phase 2 finished." << std::endl;
+              loop.stop();                                                      /// Let run() return after the pending tasks
+            },
+            make_caller(2));
+      },
+      make_caller(1));
+  loop.run();                                                                   /// Run the continuations on the main thread
+  std::cout << "Done." << std::endl;
+  return 0;
+}
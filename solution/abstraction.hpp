@@ -12,6 +12,7 @@
 #include <functional>
 #include <memory>
 #include <atomic>
+#include <cstdint>
 
 #include "requirements.hpp"
 #include "proxy.hpp"
@@ -34,6 +35,8 @@ using ConcurrentCallablePortal = poly::SharedProxy<poly::Callable<void(
     AtomicCounterModifier,
     ConcurrentCallback)>>;
 using Runnable = poly::DeepProxy<poly::Callable<void()>>;
+/* Receives the bytes transferred by an I/O, or the negated error number */
+using IoCompletion = poly::DeepProxy<poly::Callable<void(std::int64_t)>>;
 
 }
 
@@ -0,0 +1,140 @@
+/** Copyright (C) 2015-2017 Mingxin Wang - All Rights Reserved.
+ *  This is a C++ header file, which is part of the implementation
+ *  for the Concurrent Support Library.
+ *
+ *  @file     concurrent.h
+ *  @author   Mingxin Wang
+ */
+
+#ifndef _CON_LIB_ALLOCATION
+#define _CON_LIB_ALLOCATION
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace con {
+
+/* Allocation accounting is compiled in only when
+ * CON_LIB_ALLOCATION_ACCOUNTING is defined, otherwise the scopes are empty.
+ * The library marks the code that allocates with the component it belongs
+ * to, and a program that replaces the global operator new shall call
+ * on_allocate(), which passes the size and the component marked on the
+ * calling thread to the hook. The default hook counts the allocations per
+ * component. */
+namespace allocation {
+
+enum class Component : std::size_t {
+  /* Anything not marked, including the procedures */
+  USER,
+  ATOMIC_COUNTER,
+  SEMAPHORE,
+  /* Type erasure of the callables, modifiers and callbacks being submitted */
+  TASK,
+  /* Bound tasks, queue nodes and threads made by the portals */
+  PORTAL,
+  /* Linear buffers of the modifiers */
+  BUFFER,
+  CALLER
+};
+
+constexpr std::size_t COMPONENT_COUNT = 7u;
+
+inline const char* component_name(Component component) {
+  static const char* const NAMES[COMPONENT_COUNT] = {
+      "user", "atomic_counter", "semaphore", "task", "portal", "buffer",
+      "caller"};
+  return NAMES[(std::size_t)component];
+}
+
+struct Usage {
+  std::uint64_t count_;
+  std::uint64_t bytes_;
+};
+
+using Report = std::array<Usage, COMPONENT_COUNT>;
+
+using Hook = void (*)(Component component, std::size_t size);
+
+#ifdef CON_LIB_ALLOCATION_ACCOUNTING
+
+inline Component& current_component() {
+  static thread_local Component component = Component::USER;
+  return component;
+}
+
+class Scope {
+ public:
+  explicit Scope(Component component) : previous_(current_component()) {
+    current_component() = component;
+  }
+
+  Scope(const Scope&) = delete;
+
+  ~Scope() { current_component() = previous_; }
+
+ private:
+  const Component previous_;
+};
+
+struct AtomicUsage {
+  std::atomic<std::uint64_t> count_;
+  std::atomic<std::uint64_t> bytes_;
+};
+
+inline std::array<AtomicUsage, COMPONENT_COUNT>& usages() {
+  static std::array<AtomicUsage, COMPONENT_COUNT> result{};
+  return result;
+}
+
+inline void count(Component component, std::size_t size) {
+  AtomicUsage& usage = usages()[(std::size_t)component];
+  usage.count_.fetch_add(1u, std::memory_order_relaxed);
+  usage.bytes_.fetch_add(size, std::memory_order_relaxed);
+}
+
+inline std::atomic<Hook>& hook() {
+  static std::atomic<Hook> result(count);
+  return result;
+}
+
+/* Shall not allocate, for it is called inside operator new */
+inline void set_hook(Hook h) { hook().store(h, std::memory_order_relaxed); }
+
+inline void on_allocate(std::size_t size) {
+  hook().load(std::memory_order_relaxed)(current_component(), size);
+}
+
+/* Returns what the default hook has counted */
+inline Report report() {
+  Report result;
+  for (std::size_t i = 0u; i < COMPONENT_COUNT; ++i) {
+    result[i].count_ = usages()[i].count_.load(std::memory_order_relaxed);
+    result[i].bytes_ = usages()[i].bytes_.load(std::memory_order_relaxed);
+  }
+  return result;
+}
+
+#else
+
+class Scope {
+ public:
+  explicit Scope(Component) {}
+
+  Scope(const Scope&) = delete;
+};
+
+inline void set_hook(Hook) {}
+
+inline void on_allocate(std::size_t) {}
+
+inline Report report() { return Report{}; }
+
+#endif // CON_LIB_ALLOCATION_ACCOUNTING
+
+}
+
+}
+
+#endif // _CON_LIB_ALLOCATION
@@ -0,0 +1,462 @@
+/** Copyright (C) 2015-2017 Mingxin Wang - All Rights Reserved.
+ *  This is a C++ header file, which is part of the implementation
+ *  for the Concurrent Support Library.
+ *
+ *  @file     concurrent.h
+ *  @author   Mingxin Wang
+ */
+
+#ifndef _CON_LIB_ASYNC_IO
+#define _CON_LIB_ASYNC_IO
+
+#ifdef __linux__
+
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <utility>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#define CON_LIB_HAS_IO_URING
+#endif // __has_include(<linux/io_uring.h>)
+
+#include "requirements.hpp"
+#include "allocation.hpp"
+#include "abstraction.hpp"
+#include "core.hpp"
+#include "portal.hpp"
+
+namespace con {
+
+#ifdef CON_LIB_HAS_IO_URING
+/* An io_uring set up with raw system calls. Any thread may submit, and the
+ * completions are run on the thread that calls execute(). At most half of
+ * the completion queue is in flight, so that the completions and their
+ * cancellations always fit in it. A submission waits for room, except the
+ * ones made by a completion, which are deferred until the completion thread
+ * has drained the queue. The I/O still in flight at shutdown is cancelled,
+ * so that a read that never completes does not keep the thread alive. */
+class IoUring {
+ public:
+  explicit IoUring(unsigned entries)
+      : fd_(-1),
+        sq_ring_(MAP_FAILED),
+        cq_ring_(MAP_FAILED),
+        sqes_(MAP_FAILED),
+        head_(nullptr),
+        in_flight_(0u),
+        is_shutdown_(false) {
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    fd_ = (int)syscall(__NR_io_uring_setup, entries, &params);
+    if (fd_ == -1) {
+      throw std::system_error(errno, std::system_category());
+    }
+    if (!supports(IORING_OP_READ) || !supports(IORING_OP_WRITE) ||
+        !supports(IORING_OP_ASYNC_CANCEL)) {
+      release();
+      throw std::system_error(std::make_error_code(
+          std::errc::function_not_supported));
+    }
+    sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_ring_size_ = params.cq_off.cqes
+        + params.cq_entries * sizeof(io_uring_cqe);
+    sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+    bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0u;
+    if (single_mmap) {
+      sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+    }
+    sq_ring_ = mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQ_RING);
+    cq_ring_ = single_mmap ? sq_ring_ : mmap(
+        nullptr, cq_ring_size_, PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_CQ_RING);
+    sqes_ = mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE,
+                 MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQES);
+    if (sq_ring_ == MAP_FAILED || cq_ring_ == MAP_FAILED ||
+        sqes_ == MAP_FAILED) {
+      int error = errno;
+      release();
+      throw std::system_error(error, std::system_category());
+    }
+    char* sq = static_cast<char*>(sq_ring_);
+    char* cq = static_cast<char*>(cq_ring_);
+    sq_tail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sq_mask_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sq_array_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    cq_head_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cq_tail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cq_mask_ = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+    limit_ = std::max(params.cq_entries / 2u, 1u);
+  }
+
+  IoUring(const IoUring&) = delete;
+
+  ~IoUring() { release(); }
+
+  /* Runs the completions until the ring is shut down and no I/O is in
+   * flight */
+  void execute() {
+    is_completion_thread() = true;
+    for (;;) {
+      unsigned head = *cq_head_;
+      unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+      while (head != tail) {
+        const io_uring_cqe& cqe = cqes_[head & cq_mask_];
+        std::unique_ptr<Operation> operation(
+            reinterpret_cast<Operation*>(cqe.user_data));
+        std::int64_t result = cqe.res;
+        __atomic_store_n(cq_head_, ++head, __ATOMIC_RELEASE);
+        if ((bool)operation) {
+          {
+            std::lock_guard<std::mutex> lk(mtx_);
+            unlink(operation.get());
+            --in_flight_;
+          }
+          cond_.notify_one();
+          operation->completion_(result);
+        }
+      }
+      if (resume()) {
+        break;
+      }
+      enter(0u, 1u, IORING_ENTER_GETEVENTS);
+    }
+    is_completion_thread() = false;
+  }
+
+  void shutdown() {
+    std::lock_guard<std::mutex> lk(mtx_);
+    is_shutdown_ = true;
+    if (head_ == nullptr) {
+      /* Wakes up the completion thread */
+      push(IORING_OP_NOP, -1, nullptr, 0u, 0u, nullptr);
+    }
+    for (Operation* operation = head_; operation != nullptr;
+         operation = operation->next_) {
+      push(IORING_OP_ASYNC_CANCEL, -1, operation, 0u, 0u, nullptr);
+    }
+  }
+
+  void submit(std::uint8_t opcode, int fd, void* buffer, std::size_t size,
+              std::uint64_t offset, abstraction::IoCompletion&& completion) {
+    std::unique_ptr<Operation> operation;
+    {
+      allocation::Scope scope(allocation::Component::PORTAL);
+      operation.reset(new Operation{std::move(completion), opcode, fd, buffer,
+                                    size, offset, nullptr, nullptr});
+    }
+    {
+      std::unique_lock<std::mutex> lk(mtx_);
+      if (!is_shutdown_) {
+        if (!is_completion_thread()) {
+          cond_.wait(lk, [&] {
+            return in_flight_ < limit_ && backlog_.empty();
+          });
+        }
+        if (in_flight_ < limit_ && backlog_.empty()) {
+          start(operation.release());
+        } else {
+          allocation::Scope scope(allocation::Component::PORTAL);
+          backlog_.push_back(operation.release());
+        }
+        return;
+      }
+    }
+    operation->completion_(-(std::int64_t)ECANCELED);
+  }
+
+ private:
+  static bool& is_completion_thread() {
+    static thread_local bool result = false;
+    return result;
+  }
+
+  struct Operation {
+    abstraction::IoCompletion completion_;
+    std::uint8_t opcode_;
+    int fd_;
+    void* buffer_;
+    std::size_t size_;
+    std::uint64_t offset_;
+    Operation* prev_;
+    Operation* next_;
+  };
+
+  /* Starts the deferred submissions that fit, or cancels them once the ring
+   * is shut down. Returns whether the ring is shut down with nothing left */
+  bool resume() {
+    Operation* cancelled = nullptr;
+    bool result;
+    {
+      std::lock_guard<std::mutex> lk(mtx_);
+      while (!backlog_.empty() && (is_shutdown_ || in_flight_ < limit_)) {
+        Operation* operation = backlog_.front();
+        backlog_.pop_front();
+        if (is_shutdown_) {
+          operation->next_ = cancelled;
+          cancelled = operation;
+        } else {
+          start(operation);
+        }
+      }
+      result = is_shutdown_ && in_flight_ == 0u;
+    }
+    cond_.notify_one();
+    while (cancelled != nullptr) {
+      std::unique_ptr<Operation> operation(cancelled);
+      cancelled = cancelled->next_;
+      operation->completion_(-(std::int64_t)ECANCELED);
+    }
+    return result;
+  }
+
+  /* Shall be called with the lock held */
+  void start(Operation* operation) {
+    operation->prev_ = nullptr;
+    operation->next_ = head_;
+    if (head_ != nullptr) {
+      head_->prev_ = operation;
+    }
+    head_ = operation;
+    ++in_flight_;
+    push(operation->opcode_, operation->fd_, operation->buffer_,
+         operation->size_, operation->offset_, operation);
+  }
+
+  /* Shall be called with the lock held */
+  void unlink(Operation* operation) {
+    if (operation->prev_ != nullptr) {
+      operation->prev_->next_ = operation->next_;
+    } else {
+      head_ = operation->next_;
+    }
+    if (operation->next_ != nullptr) {
+      operation->next_->prev_ = operation->prev_;
+    }
+  }
+
+  /* The operations are probed, for the kernels that have io_uring but not
+   * the plain read and write */
+  bool supports(std::uint8_t opcode) const {
+    constexpr unsigned OPS = 256u;
+    std::unique_ptr<char[]> memory(
+        new char[sizeof(io_uring_probe) + OPS * sizeof(io_uring_probe_op)]());
+    io_uring_probe* probe = reinterpret_cast<io_uring_probe*>(memory.get());
+    return syscall(__NR_io_uring_register, fd_, IORING_REGISTER_PROBE, probe,
+                   OPS) != -1 && opcode <= probe->last_op &&
+        (probe->ops[opcode].flags & IO_URING_OP_SUPPORTED) != 0u;
+  }
+
+  /* Shall be called with the lock held */
+  void push(std::uint8_t opcode, int fd, void* buffer, std::size_t size,
+            std::uint64_t offset, Operation* operation) {
+    unsigned tail = *sq_tail_;
+    unsigned index = tail & sq_mask_;
+    io_uring_sqe& sqe = static_cast<io_uring_sqe*>(sqes_)[index];
+    std::memset(&sqe, 0, sizeof(sqe));
+    sqe.opcode = opcode;
+    sqe.fd = fd;
+    sqe.addr = reinterpret_cast<std::uint64_t>(buffer);
+    sqe.len = (std::uint32_t)size;
+    sqe.off = offset;
+    sqe.user_data = reinterpret_cast<std::uint64_t>(operation);
+    sq_array_[index] = index;
+    __atomic_store_n(sq_tail_, tail + 1u, __ATOMIC_RELEASE);
+    enter(1u, 0u, 0u);
+  }
+
+  /* EBUSY is not retried, since it reports an overflowed completion queue,
+   * which the bound on the I/O in flight rules out */
+  void enter(unsigned to_submit, unsigned min_complete, unsigned flags) {
+    while (syscall(__NR_io_uring_enter, fd_, to_submit, min_complete, flags,
+                   nullptr, 0) == -1) {
+      if (errno != EINTR && errno != EAGAIN) {
+        throw std::system_error(errno, std::system_category());
+      }
+    }
+  }
+
+  void release() {
+    if (sqes_ != MAP_FAILED) {
+      munmap(sqes_, sqes_size_);
+    }
+    if (cq_ring_ != MAP_FAILED && cq_ring_ != sq_ring_) {
+      munmap(cq_ring_, cq_ring_size_);
+    }
+    if (sq_ring_ != MAP_FAILED) {
+      munmap(sq_ring_, sq_ring_size_);
+    }
+    if (fd_ != -1) {
+      close(fd_);
+    }
+  }
+
+  int fd_;
+  void* sq_ring_;
+  void* cq_ring_;
+  void* sqes_;
+  std::size_t sq_ring_size_;
+  std::size_t cq_ring_size_;
+  std::size_t sqes_size_;
+  unsigned* sq_tail_;
+  unsigned sq_mask_;
+  unsigned* sq_array_;
+  unsigned* cq_head_;
+  unsigned* cq_tail_;
+  unsigned cq_mask_;
+  io_uring_cqe* cqes_;
+  unsigned limit_;
+  std::mutex mtx_;
+  std::condition_variable cond_;
+  Operation* head_;
+  std::deque<Operation*> backlog_;
+  unsigned in_flight_;
+  bool is_shutdown_;
+};
+#endif // CON_LIB_HAS_IO_URING
+
+/* Positional file I/O that completes asynchronously. It goes through an
+ * io_uring when the kernel supports it, otherwise the blocking pread() and
+ * pwrite() are run on a thread pool. The writes to a regular file always go
+ * to the pool: the kernel cannot complete a buffered write without blocking,
+ * so it hands them to the io_uring workers, which serialize the writes to
+ * the same file (about 10 times slower than the pool in benchmark_9). The
+ * copies share the same ring and pool, which are shut down when the last of
+ * them is destroyed. */
+class AsyncFileIo {
+ public:
+  explicit AsyncFileIo(
+      unsigned entries = 256u,
+      std::size_t fallback_concurrency = std::thread::hardware_concurrency(),
+      bool use_io_uring = true)
+      : pool_(std::make_shared<ThreadPoolPortal<>>(
+            std::max<std::size_t>(fallback_concurrency, 1u))) {
+#ifdef CON_LIB_HAS_IO_URING
+    if (use_io_uring) {
+      try {
+        auto ring = std::make_shared<IoUring>(entries);
+        /* The completion thread holds the ring by itself, and the last copy
+         * shuts it down */
+        ring_ = std::shared_ptr<IoUring>(
+            ring.get(), [ring](IoUring*) { ring->shutdown(); });
+        ThreadPortal<false>()([ring] { ring->execute(); });
+      } catch (const std::system_error&) {}
+    }
+#endif // CON_LIB_HAS_IO_URING
+  }
+
+  AsyncFileIo(const AsyncFileIo&) = default;
+
+  AsyncFileIo& operator=(const AsyncFileIo&) = default;
+
+  bool uses_io_uring() const {
+#ifdef CON_LIB_HAS_IO_URING
+    return (bool)ring_;
+#else
+    return false;
+#endif // CON_LIB_HAS_IO_URING
+  }
+
+  template <class F>
+  void read(int fd, void* buffer, std::size_t size, std::uint64_t offset,
+            F&& completion) const requires
+      requirements::Callable<F, void, std::int64_t>() {
+#ifdef CON_LIB_HAS_IO_URING
+    if ((bool)ring_) {
+      ring_->submit(IORING_OP_READ, fd, buffer, size, offset,
+                    std::forward<F>(completion));
+      return;
+    }
+#endif // CON_LIB_HAS_IO_URING
+    (*pool_)([=, completion = std::decay_t<F>(std::forward<F>(completion))]
+        () mutable {
+      ssize_t result = pread(fd, buffer, size, (off_t)offset);
+      completion(result == -1 ? -(std::int64_t)errno : (std::int64_t)result);
+    });
+  }
+
+  template <class F>
+  void write(int fd, const void* buffer, std::size_t size,
+             std::uint64_t offset, F&& completion) const requires
+      requirements::Callable<F, void, std::int64_t>() {
+#ifdef CON_LIB_HAS_IO_URING
+    struct stat status;
+    if ((bool)ring_ && (fstat(fd, &status) != 0 || !S_ISREG(status.st_mode))) {
+      ring_->submit(IORING_OP_WRITE, fd, const_cast<void*>(buffer), size,
+                    offset, std::forward<F>(completion));
+      return;
+    }
+#endif // CON_LIB_HAS_IO_URING
+    (*pool_)([=, completion = std::decay_t<F>(std::forward<F>(completion))]
+        () mutable {
+      ssize_t result = pwrite(fd, buffer, size, (off_t)offset);
+      completion(result == -1 ? -(std::int64_t)errno : (std::int64_t)result);
+    });
+  }
+
+ private:
+#ifdef CON_LIB_HAS_IO_URING
+  std::shared_ptr<IoUring> ring_;
+#endif // CON_LIB_HAS_IO_URING
+  std::shared_ptr<ThreadPoolPortal<>> pool_;
+};
+
+/* The procedure forks one more count for the I/O and returns without
+ * waiting, and the completion calls F with the result and joins that count,
+ * so that no thread is blocked while the I/O is in flight */
+template <class F>
+auto make_async_read_procedure(const AsyncFileIo& io, int fd, void* buffer,
+                               std::size_t size, std::uint64_t offset,
+                               F&& completion) requires
+    requirements::Callable<F, void, std::int64_t>() {
+  return [io, fd, buffer, size, offset,
+          completion = std::decay_t<F>(std::forward<F>(completion))](
+      auto&& modifier, const auto& callback) {
+    io.read(
+        fd, buffer, size, offset,
+        [completion, modifier = modifier.increase(1u).fetch(),
+         callback = copy_construct(callback)](std::int64_t result) mutable {
+          completion(result);
+          concurrent_join(modifier, callback);
+        });
+  };
+}
+
+template <class F>
+auto make_async_write_procedure(const AsyncFileIo& io, int fd,
+                                const void* buffer, std::size_t size,
+                                std::uint64_t offset, F&& completion) requires
+    requirements::Callable<F, void, std::int64_t>() {
+  return [io, fd, buffer, size, offset,
+          completion = std::decay_t<F>(std::forward<F>(completion))](
+      auto&& modifier, const auto& callback) {
+    io.write(
+        fd, buffer, size, offset,
+        [completion, modifier = modifier.increase(1u).fetch(),
+         callback = copy_construct(callback)](std::int64_t result) mutable {
+          completion(result);
+          concurrent_join(modifier, callback);
+        });
+  };
+}
+
+}
+
+#endif // __linux__
+
+#endif // _CON_LIB_ASYNC_IO
@@ -13,6 +13,8 @@
 #include <atomic>
 #include <stack>
 
+#include "allocation.hpp"
+
 namespace con {
 
 template <class T>
@@ -32,6 +34,7 @@ template <class T, template <class, class...> class Container = std::stack>
 class StackedLinearBuffer {
  public:
   void push(std::size_t num, T&& cur) {
+    allocation::Scope scope(allocation::Component::BUFFER);
     container_.emplace(num, std::forward<T>(cur));
   }
 
@@ -82,6 +85,7 @@ class BasicAtomicCounter {
   class Initializer {
    public:
     SingleElementBuffer<Modifier> operator()(std::size_t init_count) const {
+      allocation::Scope scope(allocation::Component::ATOMIC_COUNTER);
       return SingleElementBuffer<Modifier>(Modifier(new std::atomic_size_t(init_count)));
     }
   };
@@ -165,6 +169,7 @@ class TreeAtomicCounter {
   static void init_node(Node* parent,
                        std::size_t init_count,
                        StackedLinearBuffer<Modifier>& buffer) {
+    allocation::Scope scope(allocation::Component::ATOMIC_COUNTER);
     while (MAX_COUNT < init_count) {
       parent = new Node(parent, MAX_COUNT);
       buffer.push(MAX_COUNT, Modifier(parent));
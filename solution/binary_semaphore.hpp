@@ -31,6 +31,8 @@
 #include <unistd.h>
 #endif // defined(_GLIBCXX_HAVE_LINUX_FUTEX) && ATOMIC_INT_LOCK_FREE > 1
 
+#include "allocation.hpp"
+
 namespace con {
 
 class SpinBinarySemaphore {
@@ -159,14 +161,87 @@ class LinuxFutexBinarySemaphore {
 
 class DisposableBinarySemaphore {
  public:
+  DisposableBinarySemaphore() : prom_(make_promise()) {}
+
   void wait() { prom_.get_future().wait(); }
 
   void release() { prom_.set_value(); }
 
  private:
+  static std::promise<void> make_promise() {
+    allocation::Scope scope(allocation::Component::SEMAPHORE);
+    return std::promise<void>();
+  }
+
   std::promise<void> prom_;
 };
 
+/* A queue of tasks that a thread waiting for a synchronous invocation can
+ * help, for the thread may be the one that is expected to run them */
+class TaskExecutor {
+ public:
+  /* Runs the queued tasks on the calling thread until "done" is set, and
+   * waits on "cond" while there is none */
+  virtual void run_until(const std::atomic_bool& done,
+                         std::condition_variable& cond) = 0;
+
+  /* Sets "done" and wakes the thread that waits on "cond" in run_until() */
+  virtual void release(std::atomic_bool& done,
+                       std::condition_variable& cond) = 0;
+
+ protected:
+  ~TaskExecutor() = default;
+};
+
+/* The executor that the calling thread works for, if any */
+inline TaskExecutor*& current_task_executor() {
+  static thread_local TaskExecutor* executor = nullptr;
+  return executor;
+}
+
+/* Disposable. When waited on by a thread that works for an executor, such as
+ * a pool worker, the thread runs the other queued tasks until the semaphore
+ * is released, so that a nested synchronous invocation neither parks the
+ * worker nor deadlocks a small pool. Other threads block. The waiter is woken
+ * by new work as well as by its own release, which does not wake the other
+ * threads of the executor. The tasks it runs are stacked on top of the
+ * waiter, so that a waiter that holds a lock, or that one of those tasks
+ * waits for, is deadlocked. It is therefore not the default, and is chosen
+ * with sync_concurrent_invoke_explicit() where no task depends on the
+ * waiter. */
+class HelpingBinarySemaphore {
+ public:
+  HelpingBinarySemaphore()
+      : executor_(current_task_executor()), done_(false) {}
+
+  void wait() {
+    if (executor_ != nullptr) {
+      executor_->run_until(done_, cond_);
+    } else {
+      std::unique_lock<std::mutex> lk(mtx_);
+      cond_.wait(lk, [&] { return done_.load(std::memory_order_relaxed); });
+    }
+  }
+
+  /* The semaphore may be destroyed as soon as the waiter sees "done", which
+   * is set and notified under the lock of the waiter */
+  void release() {
+    if (executor_ != nullptr) {
+      executor_->release(done_, cond_);
+    } else {
+      std::lock_guard<std::mutex> lk(mtx_);
+      done_.store(true, std::memory_order_relaxed);
+      cond_.notify_one();
+    }
+  }
+
+ private:
+  TaskExecutor* const executor_;
+  std::atomic_bool done_;
+  std::mutex mtx_;
+  std::condition_variable cond_;
+};
+
 }
 
 #endif // _CON_LIB_BINARY_SEMAPHORE
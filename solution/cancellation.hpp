@@ -0,0 +1,79 @@
+/** Copyright (C) 2015-2017 Mingxin Wang - All Rights Reserved.
+ *  This is a C++ header file, which is part of the implementation
+ *  for the Concurrent Support Library.
+ *
+ *  @file     concurrent.h
+ *  @author   Mingxin Wang
+ */
+
+#ifndef _CON_LIB_CANCELLATION
+#define _CON_LIB_CANCELLATION
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+namespace con {
+
+/* Shared by every task of a fork tree, checking it is a single relaxed load */
+class CancellationToken {
+ public:
+  CancellationToken() : state_(std::make_shared<std::atomic_bool>(false)) {}
+
+  /* A token that is never cancelled */
+  explicit CancellationToken(std::nullptr_t) {}
+
+  CancellationToken(const CancellationToken&) = default;
+
+  CancellationToken& operator=(const CancellationToken&) = default;
+
+  void cancel() const {
+    if ((bool)state_) {
+      state_->store(true, std::memory_order_relaxed);
+    }
+  }
+
+  bool is_cancelled() const {
+    return (bool)state_ && state_->load(std::memory_order_relaxed);
+  }
+
+ private:
+  std::shared_ptr<std::atomic_bool> state_;
+};
+
+inline const CancellationToken*& current_cancellation_token_pointer() {
+  static thread_local const CancellationToken* current = nullptr;
+  return current;
+}
+
+/* The token of the task running on the current thread, tasks submitted from
+ * the current thread inherit it */
+inline CancellationToken current_cancellation_token() {
+  const CancellationToken* current = current_cancellation_token_pointer();
+  return current == nullptr ? CancellationToken(nullptr) : *current;
+}
+
+inline bool is_cancelled() {
+  const CancellationToken* current = current_cancellation_token_pointer();
+  return current != nullptr && current->is_cancelled();
+}
+
+/* Makes the token current on this thread until the end of the scope */
+class CancellationScope {
+ public:
+  explicit CancellationScope(const CancellationToken& token)
+      : previous_(current_cancellation_token_pointer()) {
+    current_cancellation_token_pointer() = &token;
+  }
+
+  CancellationScope(const CancellationScope&) = delete;
+
+  ~CancellationScope() { current_cancellation_token_pointer() = previous_; }
+
+ private:
+  const CancellationToken* const previous_;
+};
+
+}
+
+#endif // _CON_LIB_CANCELLATION
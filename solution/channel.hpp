@@ -0,0 +1,325 @@
+/** Copyright (C) 2015-2017 Mingxin Wang - All Rights Reserved.
+ *  This is a C++ header file, which is part of the implementation
+ *  for the Concurrent Support Library.
+ *
+ *  @file     concurrent.h
+ *  @author   Mingxin Wang
+ */
+
+#ifndef _CON_LIB_CHANNEL
+#define _CON_LIB_CHANNEL
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+
+#include "core.hpp"
+#include "lock_free_queue.hpp"
+#include "concurrent_procedure.hpp"
+
+namespace con {
+
+/* The threads parked on one side of a channel, each on its own binary
+ * semaphore. The lock is only taken by the threads that are about to park
+ * and by the ones that wake them, never on the path of a value. */
+class ChannelWaitList {
+ public:
+  ChannelWaitList() : waiting_(0u), head_(nullptr), tail_(nullptr) {}
+
+  ChannelWaitList(const ChannelWaitList&) = delete;
+
+  /* Registers the calling thread, then parks it unless "ready" returns true.
+   * Returns what "ready" returned. A notification taken by a thread that
+   * no longer needed it is passed on to the next waiter. */
+  template <class BinarySemaphore, class Predicate>
+  bool park(Predicate&& ready) {
+    BinarySemaphore semaphore;
+    Waiter waiter(semaphore);
+    {
+      std::lock_guard<std::mutex> lk(mtx_);
+      link(waiter);
+      waiting_.fetch_add(1u, std::memory_order_relaxed);
+    }
+    /* Pairs with the fence in notify_one(), so that either the notifier sees
+     * this waiter or "ready" sees what the notifier did */
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    bool result = ready();
+    if (result) {
+      std::lock_guard<std::mutex> lk(mtx_);
+      if (waiter.linked_) {
+        unlink(waiter);
+        return true;
+      }
+    }
+    /* A notifier has unlinked the waiter, and is about to release it */
+    semaphore.wait();
+    if (result) {
+      notify_one();
+    }
+    return result;
+  }
+
+  void notify_one() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (waiting_.load(std::memory_order_relaxed) == 0u) {
+      return;
+    }
+    Waiter* waiter;
+    {
+      std::lock_guard<std::mutex> lk(mtx_);
+      waiter = head_;
+      if (waiter == nullptr) {
+        return;
+      }
+      unlink(*waiter);
+    }
+    waiter->release_(waiter->semaphore_);
+  }
+
+  void notify_all() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (waiting_.load(std::memory_order_relaxed) == 0u) {
+      return;
+    }
+    Waiter* waiters;
+    {
+      std::lock_guard<std::mutex> lk(mtx_);
+      waiters = head_;
+      for (Waiter* current = head_; current != nullptr;
+           current = current->next_) {
+        current->linked_ = false;
+      }
+      head_ = tail_ = nullptr;
+      waiting_.store(0u, std::memory_order_relaxed);
+    }
+    while (waiters != nullptr) {
+      /* The waiter may be gone as soon as it is released */
+      Waiter* next = waiters->next_;
+      waiters->release_(waiters->semaphore_);
+      waiters = next;
+    }
+  }
+
+ private:
+  struct Waiter {
+    template <class BinarySemaphore>
+    explicit Waiter(BinarySemaphore& semaphore)
+        : semaphore_(&semaphore),
+          release_([](void* semaphore) {
+            static_cast<BinarySemaphore*>(semaphore)->release();
+          }),
+          linked_(false), prev_(nullptr), next_(nullptr) {}
+
+    void* const semaphore_;
+    void (* const release_)(void*);
+    bool linked_;
+    Waiter* prev_;
+    Waiter* next_;
+  };
+
+  void link(Waiter& waiter) {
+    waiter.linked_ = true;
+    waiter.prev_ = tail_;
+    waiter.next_ = nullptr;
+    (tail_ == nullptr ? head_ : tail_->next_) = &waiter;
+    tail_ = &waiter;
+  }
+
+  void unlink(Waiter& waiter) {
+    waiter.linked_ = false;
+    (waiter.prev_ == nullptr ? head_ : waiter.prev_->next_) = waiter.next_;
+    (waiter.next_ == nullptr ? tail_ : waiter.next_->prev_) = waiter.prev_;
+    waiting_.fetch_sub(1u, std::memory_order_relaxed);
+  }
+
+  std::atomic_size_t waiting_;
+  std::mutex mtx_;
+  Waiter* head_;
+  Waiter* tail_;
+};
+
+/* Carries values between concurrently invoked procedures through a
+ * lock-free queue: LockFreeBoundedQueue for any number of producers and
+ * consumers, LockFreeSpscQueue or LockFreeUnboundedSpscQueue for one of
+ * each. The senders block while a bounded queue is full, and the receivers
+ * while it is empty, parked on binary semaphores. After close() no send
+ * succeeds, but the values sent before are still received, and a receive
+ * fails once there is nothing left. The semaphores block by default rather
+ * than help the pool, for a helping receiver may run a sender on top of its
+ * own stack, and would never be woken once that sender waits for room. The
+ * senders and receivers that wait for each other shall be able to run at
+ * the same time, as the stages of a pipeline. */
+template <class T, class Queue = LockFreeBoundedQueue<T>>
+class Channel {
+ public:
+  template <class... Args>
+  explicit Channel(Args&&... args)
+      : queue_(std::forward<Args>(args)...), state_(0u) {}
+
+  Channel(const Channel&) = delete;
+
+  /* Fails if the queue is full or the channel is closed */
+  template <class U>
+  bool try_send(U&& value) {
+    if (!enter()) {
+      return false;
+    }
+    bool result = queue_.try_push(std::forward<U>(value));
+    if (result) {
+      not_empty_.notify_one();
+    }
+    leave();
+    return result;
+  }
+
+  /* Fails only if the channel is closed */
+  template <class BinarySemaphore = BlockingBinarySemaphore, class U>
+  bool send(U&& value) {
+    if (!enter()) {
+      return false;
+    }
+    push<BinarySemaphore>(std::forward<U>(value));
+    leave();
+    return true;
+  }
+
+  /* Sends the values in order, and returns how many are sent, which is less
+   * than all of them only if the channel is closed */
+  template <class BinarySemaphore = BlockingBinarySemaphore, class InputIt>
+  std::size_t send_batch(InputIt first, InputIt last) {
+    if (!enter()) {
+      return 0u;
+    }
+    std::size_t result = 0u;
+    for (; first != last; ++first, ++result) {
+      push<BinarySemaphore>(*first);
+    }
+    leave();
+    return result;
+  }
+
+  /* Fails if the queue is empty */
+  bool try_receive(T& value) {
+    if (!queue_.try_pop(value)) {
+      return false;
+    }
+    not_full_.notify_one();
+    return true;
+  }
+
+  /* Fails only if the channel is closed, and every value is received */
+  template <class BinarySemaphore = BlockingBinarySemaphore>
+  bool receive(T& value) {
+    for (;;) {
+      if (try_receive(value)) {
+        return true;
+      }
+      if (finished()) {
+        /* Every value sent happens before the channel is finished */
+        return try_receive(value);
+      }
+      bool received = false;
+      not_empty_.template park<BinarySemaphore>([&] {
+        received = queue_.try_pop(value);
+        return received || finished();
+      });
+      if (received) {
+        not_full_.notify_one();
+        return true;
+      }
+    }
+  }
+
+  /* Waits for a value, then takes up to "max" of them without waiting, and
+   * returns how many are taken, which is 0 only if the channel is closed and
+   * every value is received */
+  template <class BinarySemaphore = BlockingBinarySemaphore, class OutputIt>
+  std::size_t receive_batch(OutputIt out, std::size_t max) {
+    T value;
+    if (max == 0u || !receive<BinarySemaphore>(value)) {
+      return 0u;
+    }
+    std::size_t result = 0u;
+    do {
+      *out = std::move(value);
+      ++out;
+    } while (++result < max && try_receive(value));
+    return result;
+  }
+
+  void close() {
+    if (state_.fetch_or(CLOSED, std::memory_order_acq_rel) == 0u) {
+      not_empty_.notify_all();
+    }
+  }
+
+  bool closed() const {
+    return (state_.load(std::memory_order_acquire) & CLOSED) != 0u;
+  }
+
+ private:
+  /* The lowest bit of the state is set when the channel is closed, and the
+   * others count the sends in progress */
+  static constexpr std::size_t CLOSED = 1u;
+  static constexpr std::size_t SENDER = 2u;
+
+  bool enter() {
+    if (state_.fetch_add(SENDER, std::memory_order_acquire) & CLOSED) {
+      leave();
+      return false;
+    }
+    return true;
+  }
+
+  /* The last send to leave a closed channel wakes every receiver */
+  void leave() {
+    if (state_.fetch_sub(SENDER, std::memory_order_acq_rel) ==
+        (CLOSED | SENDER)) {
+      not_empty_.notify_all();
+    }
+  }
+
+  bool finished() const {
+    return state_.load(std::memory_order_acquire) == CLOSED;
+  }
+
+  template <class BinarySemaphore, class U>
+  void push(U&& value) {
+    while (!queue_.try_push(std::forward<U>(value)) &&
+           !not_full_.template park<BinarySemaphore>([&] {
+             return queue_.try_push(std::forward<U>(value));
+           })) {}
+    not_empty_.notify_one();
+  }
+
+  Queue queue_;
+  std::atomic_size_t state_;
+  ChannelWaitList not_empty_;
+  ChannelWaitList not_full_;
+};
+
+template <class T>
+using SpscChannel = Channel<T, LockFreeSpscQueue<T>>;
+
+template <class T>
+using UnboundedSpscChannel = Channel<T, LockFreeUnboundedSpscQueue<T>>;
+
+/* Calls f with every value received from the channel, so that the invoke
+ * the procedure belongs to is not joined before the channel is closed and
+ * drained */
+template <class T, class Queue, class F>
+auto make_channel_receive_procedure(Channel<T, Queue>& channel, F&& f) {
+  return make_concurrent_procedure(
+      [&channel, f = std::decay_t<F>(std::forward<F>(f))]() mutable {
+        T value;
+        while (channel.receive(value)) {
+          f(std::move(value));
+        }
+      });
+}
+
+}
+
+#endif // _CON_LIB_CHANNEL
@@ -0,0 +1,238 @@
+/** Copyright (C) 2015-2017 Mingxin Wang - All Rights Reserved.
+ *  This is a C++ header file, which is part of the implementation
+ *  for the Concurrent Support Library.
+ *
+ *  @file     concurrent.h
+ *  @author   Mingxin Wang
+ */
+
+#ifndef _CON_LIB_CONCURRENCY_BUDGET
+#define _CON_LIB_CONCURRENCY_BUDGET
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <tuple>
+#include <utility>
+
+#include "requirements.hpp"
+#include "allocation.hpp"
+#include "abstraction.hpp"
+
+namespace con {
+
+/* A number of permits shared by every limited portal made with the budget
+ * and its copies. A submission takes a permit if there is one, otherwise it
+ * is queued without blocking the submitter, and a task that completes hands
+ * its permit to the first queued submission. */
+class ConcurrencyBudget {
+ public:
+  explicit ConcurrencyBudget(
+      std::size_t capacity = std::thread::hardware_concurrency())
+      : state_(std::make_shared<State>(std::max<std::size_t>(capacity, 1u))) {}
+
+  ConcurrencyBudget(const ConcurrencyBudget&) = default;
+
+  ConcurrencyBudget& operator=(const ConcurrencyBudget&) = default;
+
+  std::size_t capacity() const { return state_->capacity_; }
+
+  /* The tasks holding a permit, including the ones running */
+  std::size_t in_flight() const {
+    return state_->in_flight_.load(std::memory_order_relaxed);
+  }
+
+  std::size_t remaining() const {
+    return state_->capacity_ - std::min(state_->capacity_, in_flight());
+  }
+
+  std::size_t queued() const {
+    std::lock_guard<std::mutex> lk(state_->mtx_);
+    return state_->queue_.size();
+  }
+
+  /* How many ways a nested caller should split its work, at most
+   * "preferred" and at least 1 */
+  std::size_t split(std::size_t preferred) const {
+    return std::max<std::size_t>(1u, std::min(preferred, remaining()));
+  }
+
+  /* Whether a task holding a permit of this budget runs on this thread */
+  bool is_current() const;
+
+  /* Takes a permit if there is one */
+  bool try_acquire() const {
+    std::lock_guard<std::mutex> lk(state_->mtx_);
+    if (state_->in_flight_.load(std::memory_order_relaxed) ==
+        state_->capacity_) {
+      return false;
+    }
+    state_->in_flight_.fetch_add(1u, std::memory_order_relaxed);
+    return true;
+  }
+
+  /* Runs the submission with a permit now, or queues it */
+  void acquire(abstraction::Runnable&& submission) const {
+    {
+      std::lock_guard<std::mutex> lk(state_->mtx_);
+      if (state_->in_flight_.load(std::memory_order_relaxed) ==
+          state_->capacity_) {
+        allocation::Scope scope(allocation::Component::PORTAL);
+        state_->queue_.emplace(std::move(submission));
+        return;
+      }
+      state_->in_flight_.fetch_add(1u, std::memory_order_relaxed);
+    }
+    submission();
+  }
+
+  /* Passes the permit to the next queued submission, if any */
+  void release() const {
+    std::unique_lock<std::mutex> lk(state_->mtx_);
+    if (state_->queue_.empty()) {
+      state_->in_flight_.fetch_sub(1u, std::memory_order_relaxed);
+      return;
+    }
+    abstraction::Runnable next = std::move(state_->queue_.front());
+    state_->queue_.pop();
+    lk.unlock();
+    next();
+  }
+
+ private:
+  struct State {
+    explicit State(std::size_t capacity)
+        : capacity_(capacity), in_flight_(0u) {}
+
+    const std::size_t capacity_;
+    std::atomic_size_t in_flight_;
+    std::mutex mtx_;
+    std::queue<abstraction::Runnable> queue_;
+  };
+
+  std::shared_ptr<State> state_;
+};
+
+inline const ConcurrencyBudget*& current_concurrency_budget_pointer() {
+  static thread_local const ConcurrencyBudget* current = nullptr;
+  return current;
+}
+
+/* Makes the budget current on this thread until the end of the scope */
+class ConcurrencyBudgetScope {
+ public:
+  explicit ConcurrencyBudgetScope(const ConcurrencyBudget& budget)
+      : previous_(current_concurrency_budget_pointer()) {
+    current_concurrency_budget_pointer() = &budget;
+  }
+
+  ConcurrencyBudgetScope(const ConcurrencyBudgetScope&) = delete;
+
+  ~ConcurrencyBudgetScope() {
+    current_concurrency_budget_pointer() = previous_;
+  }
+
+ private:
+  const ConcurrencyBudget* const previous_;
+};
+
+inline bool ConcurrencyBudget::is_current() const {
+  const ConcurrencyBudget* current = current_concurrency_budget_pointer();
+  return current != nullptr && current->state_ == state_;
+}
+
+/* The split of the budget of the task running on this thread, or
+ * "preferred" outside a limited portal */
+inline std::size_t available_concurrency(
+    std::size_t preferred = std::thread::hardware_concurrency()) {
+  const ConcurrencyBudget* current = current_concurrency_budget_pointer();
+  return current == nullptr ? preferred : current->split(preferred);
+}
+
+/* Runs the task with its budget current, and releases the permit after it */
+template <class F>
+class BudgetedTask {
+ public:
+  template <class T>
+  explicit BudgetedTask(T&& f, const ConcurrencyBudget& budget)
+      : f_(std::forward<T>(f)), budget_(budget) {}
+
+  template <class... Args>
+  void operator()(Args&&... args) {
+    {
+      ConcurrencyBudgetScope scope(budget_);
+      try {
+        f_(std::forward<Args>(args)...);
+      } catch (...) {
+        budget_.release();
+        throw;
+      }
+    }
+    budget_.release();
+  }
+
+ private:
+  F f_;
+  ConcurrencyBudget budget_;
+};
+
+/* Submits the tasks to the portal only while the budget has permits, so
+ * that the portals sharing a budget never have more tasks in flight than its
+ * capacity however deeply they are nested. A task that holds a permit and
+ * finds none left runs what it submits by itself instead of queueing it, for
+ * it may be about to wait for it while every permit is held by a waiter. */
+template <class Portal = abstraction::ConcurrentCallablePortal>
+class LimitedPortal {
+ public:
+  template <class T>
+  explicit LimitedPortal(T&& portal, const ConcurrencyBudget& budget)
+      : portal_(std::forward<T>(portal)), budget_(budget) {}
+
+  LimitedPortal(const LimitedPortal&) = default;
+
+  LimitedPortal& operator=(const LimitedPortal&) = default;
+
+  template <class F, class... Args>
+  void operator()(F&& f, Args&&... args) const requires
+      requirements::Callable<F, void, Args...>() {
+    if (budget_.is_current()) {
+      if (budget_.try_acquire()) {
+        Portal portal(portal_);
+        portal(BudgetedTask<std::decay_t<F>>(std::forward<F>(f), budget_),
+               std::forward<Args>(args)...);
+      } else {
+        f(std::forward<Args>(args)...);
+      }
+      return;
+    }
+    allocation::Scope scope(allocation::Component::PORTAL);
+    budget_.acquire(abstraction::Runnable(
+        [portal = portal_, budget = budget_,
+         f = std::decay_t<F>(std::forward<F>(f)),
+         args = std::make_tuple(std::forward<Args>(args)...)]() mutable {
+          std::apply([&](auto&... args) {
+            portal(BudgetedTask<std::decay_t<F>>(std::move(f), budget),
+                   std::move(args)...);
+          }, args);
+        }));
+  }
+
+  const ConcurrencyBudget& budget() const { return budget_; }
+
+ private:
+  Portal portal_;
+  ConcurrencyBudget budget_;
+};
+
+template <class Portal>
+auto make_limited_portal(Portal&& portal, const ConcurrencyBudget& budget) {
+  return LimitedPortal<std::decay_t<Portal>>(std::forward<Portal>(portal),
+                                             budget);
+}
+
+}
+
+#endif // _CON_LIB_CONCURRENCY_BUDGET
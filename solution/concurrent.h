@@ -11,13 +11,30 @@
 
 #include "requirements.hpp"
 #include "util.hpp"
+#include "trace.hpp"
+#include "metrics.hpp"
+#include "allocation.hpp"
 #include "abstraction.hpp"
 #include "atomic_counter.hpp"
 #include "binary_semaphore.hpp"
+#include "lock_free_queue.hpp"
+#include "cancellation.hpp"
+#include "concurrency_budget.hpp"
 #include "core.hpp"
 #include "portal.hpp"
+#include "timer_wheel.hpp"
+#include "reactor.hpp"
+#include "async_io.hpp"
+#include "mapped_file.hpp"
 #include "concurrent_procedure.hpp"
 #include "concurrent_callable.hpp"
 #include "concurrent_caller.hpp"
+#include "concurrent_pipeline.hpp"
+#include "channel.hpp"
+#include "parallel_algorithm.hpp"
+#include "concurrent_memory.hpp"
+#include "concurrent_result.hpp"
+#include "reducer.hpp"
+#include "concurrent_graph.hpp"
 
 #endif // _CON_LIB
@@ -15,6 +15,10 @@
 
 #include "core.hpp"
 #include "abstraction.hpp"
+#include "cancellation.hpp"
+#include "trace.hpp"
+#include "allocation.hpp"
+#include "portal.hpp"
 
 namespace con {
 
@@ -25,16 +29,25 @@ class SinglePhaseConcurrentCallable {
   class Callable {
    public:
     explicit Callable(ConcurrentProcedure&& procedure)
-        : procedure_(std::forward<ConcurrentProcedure>(procedure)) {}
+        : procedure_(std::forward<ConcurrentProcedure>(procedure)),
+          token_(nullptr) {}
+
+    void inherit_cancellation() { token_ = current_cancellation_token(); }
 
     template <class AtomicCounterModifier, class Callback>
     void operator()(AtomicCounterModifier&& modifier, Callback&& callback) {
-      procedure_(modifier, callback);
+      if (!token_.is_cancelled()) {
+        CancellationScope scope(token_);
+        trace::TaskScope trace_scope;
+        allocation::Scope allocation_scope(allocation::Component::USER);
+        procedure_(modifier, callback);
+      }
       concurrent_join(modifier, callback);
     }
 
    private:
     ConcurrentProcedure procedure_;
+    CancellationToken token_;
   };
 
  public:
@@ -48,6 +61,8 @@ class SinglePhaseConcurrentCallable {
                   const Callback& callback) requires
       requirements::Callable<
           ConcurrentProcedure, void, AtomicCounterModifier, Callback>() {
+    callable_.inherit_cancellation();
+    allocation::Scope scope(allocation::Component::TASK);
     portal_(std::move(callable_),
             std::forward<AtomicCounterModifier>(modifier),
             copy_construct(callback));
@@ -67,19 +82,33 @@ class MultiPhaseConcurrentCallable {
    public:
     explicit Callable(ConcurrentProcedure&& procedure, Container&& rest)
         : procedure_(std::forward<ConcurrentProcedure>(procedure)),
-          rest_(std::forward<Container>(rest)) {}
+          rest_(std::forward<Container>(rest)),
+          token_(current_cancellation_token()) {}
 
+    /* The hint of the handoff is cleared whichever portal runs the phase,
+     * so that only the submission of the next phase may be continued */
     template <class AtomicCounterModifier, class Callback>
     void operator()(AtomicCounterModifier&& modifier, Callback&& callback) {
-      procedure_(modifier, callback);
+      PhaseHandoffScope handoff(false);
+      if (token_.is_cancelled()) {
+        concurrent_join(modifier, callback);
+        return;
+      }
+      CancellationScope scope(token_);
+      {
+        trace::TaskScope trace_scope;
+        allocation::Scope allocation_scope(allocation::Component::USER);
+        procedure_(modifier, callback);
+      }
       execute(std::forward<AtomicCounterModifier>(modifier),
               std::forward<Callback>(callback),
-              rest_);
+              rest_, true);
     }
 
    private:
     ConcurrentProcedure procedure_;
     Container rest_;
+    CancellationToken token_;
   };
 
  public:
@@ -94,18 +123,22 @@ class MultiPhaseConcurrentCallable {
       requirements::Callable<
           ConcurrentProcedure, void, AtomicCounterModifier, Callback>() {
     execute(std::forward<AtomicCounterModifier>(modifier),
-            copy_construct(callback), data_);
+            copy_construct(callback), data_, false);
   }
 
  private:
+  /* "continued" is set when the phase is submitted by the task that ran the
+   * previous one, so that a pool may run it on the same worker */
   template <class AtomicCounterModifier, class Callback>
   static void execute(AtomicCounterModifier&& modifier,
-                      Callback&& callback, Container& data) {
+                      Callback&& callback, Container& data, bool continued) {
     if (data.empty()) {
       concurrent_join(modifier, callback);
     } else {
       auto current = data.front();
       data.pop();
+      PhaseHandoffScope handoff(continued);
+      allocation::Scope scope(allocation::Component::TASK);
       current.first(Callable(std::move(current.second), std::move(data)),
                     std::forward<AtomicCounterModifier>(modifier),
                     std::forward<Callback>(callback));
@@ -123,6 +156,104 @@ auto make_concurrent_callable(Portal&& portal,
       std::forward<ConcurrentProcedure>(procedure));
 }
 
+template <class... Phases>
+class StaticMultiPhaseConcurrentCallable;
+
+template <>
+class StaticMultiPhaseConcurrentCallable<> {
+ public:
+  template <class AtomicCounterModifier, class Callback>
+  void operator()(AtomicCounterModifier&& modifier, Callback&& callback) {
+    concurrent_join(modifier, callback);
+  }
+};
+
+template <class Portal, class ConcurrentProcedure, class... OtherPhases>
+class StaticMultiPhaseConcurrentCallable<
+    std::pair<Portal, ConcurrentProcedure>, OtherPhases...> {
+ private:
+  using Rest = StaticMultiPhaseConcurrentCallable<OtherPhases...>;
+
+  class Callable {
+   public:
+    template <class U, class V>
+    explicit Callable(U&& procedure, V&& rest)
+        : procedure_(std::forward<U>(procedure)),
+          rest_(std::forward<V>(rest)),
+          token_(nullptr) {}
+
+    void inherit_cancellation() { token_ = current_cancellation_token(); }
+
+    /* The hint of the handoff is cleared whichever portal runs the phase,
+     * so that only the submission of the next phase may be continued */
+    template <class AtomicCounterModifier, class Callback>
+    void operator()(AtomicCounterModifier&& modifier, Callback&& callback) {
+      PhaseHandoffScope handoff(false);
+      if (token_.is_cancelled()) {
+        concurrent_join(modifier, callback);
+        return;
+      }
+      CancellationScope scope(token_);
+      {
+        trace::TaskScope trace_scope;
+        allocation::Scope allocation_scope(allocation::Component::USER);
+        procedure_(modifier, callback);
+      }
+      if constexpr (sizeof...(OtherPhases) == 0u) {
+        rest_(std::forward<AtomicCounterModifier>(modifier),
+              std::forward<Callback>(callback));
+      } else {
+        PhaseHandoffScope next_handoff;
+        rest_(std::forward<AtomicCounterModifier>(modifier),
+              std::forward<Callback>(callback));
+      }
+    }
+
+   private:
+    ConcurrentProcedure procedure_;
+    Rest rest_;
+    CancellationToken token_;
+  };
+
+ public:
+  template <class T, class... U>
+  explicit StaticMultiPhaseConcurrentCallable(T&& phase, U&&... other_phases)
+      requires (!std::is_same<std::decay_t<T>,
+                              StaticMultiPhaseConcurrentCallable>::value)
+      : portal_(std::forward<T>(phase).first),
+        callable_(std::forward<T>(phase).second,
+                  Rest(std::forward<U>(other_phases)...)) {}
+
+  template <class AtomicCounterModifier, class Callback>
+  void operator()(AtomicCounterModifier&& modifier,
+                  const Callback& callback) requires
+      requirements::Callable<
+          ConcurrentProcedure, void, AtomicCounterModifier, Callback>() {
+    callable_.inherit_cancellation();
+    allocation::Scope scope(allocation::Component::TASK);
+    portal_(std::move(callable_),
+            std::forward<AtomicCounterModifier>(modifier),
+            copy_construct(callback));
+  }
+
+ private:
+  Portal portal_;
+  Callable callable_;
+};
+
+template <class Portal, class ConcurrentProcedure>
+auto make_concurrent_phase(Portal&& portal, ConcurrentProcedure&& procedure) {
+  return std::pair<std::decay_t<Portal>, std::decay_t<ConcurrentProcedure>>(
+      std::forward<Portal>(portal),
+      std::forward<ConcurrentProcedure>(procedure));
+}
+
+template <class... Phases>
+auto make_multi_phase_concurrent_callable(Phases&&... phases) {
+  return StaticMultiPhaseConcurrentCallable<std::decay_t<Phases>...>(
+      std::forward<Phases>(phases)...);
+}
+
 }
 
 #endif // _CON_LIB_CONCURRENT_CALLABLE
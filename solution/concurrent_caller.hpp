@@ -9,13 +9,20 @@
 #ifndef _CON_LIB_CONCURRENT_CALLER
 #define _CON_LIB_CONCURRENT_CALLER
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <vector>
 #include <functional>
 #include <queue>
+#include <tuple>
+#include <type_traits>
 
 #include "core.hpp"
 #include "util.hpp"
 #include "abstraction.hpp"
+#include "allocation.hpp"
+#include "concurrency_budget.hpp"
 
 namespace con {
 
@@ -26,7 +33,7 @@ class ConcurrentCaller0D {
   explicit ConcurrentCaller0D(T&& callable)
       : callable_(std::forward<T>(callable)) {}
 
-  constexpr std::size_t size() const { return 1u; }
+  static constexpr std::size_t size() { return 1u; }
 
   template <class LinearBuffer, class Callback>
   void call(LinearBuffer& buffer, const Callback& callback) requires
@@ -53,6 +60,7 @@ class ConcurrentCaller1D {
  public:
   template <class... Args>
   void emplace(Args&&... args) {
+    allocation::Scope scope(allocation::Component::CALLER);
     data_.emplace_back(std::forward<Args>(args)...);
   }
 
@@ -83,18 +91,239 @@ auto make_concurrent_caller(std::size_t count,
   return res;
 }
 
+/* Keeps up to N callables inline, so that a caller built at runtime with a
+ * few callables allocates nothing */
+template <class ConcurrentCallable = abstraction::ConcurrentCallable,
+          std::size_t N = 8u>
+using SmallConcurrentCaller1D = ConcurrentCaller1D<
+    ConcurrentCallable, SmallVector<ConcurrentCallable, N>>;
+
+/* Stores a fixed set of callables of different types inline, and calls each
+ * of them directly, without the type erasure and the container that mixing
+ * them in a ConcurrentCaller1D takes */
+template <class... ConcurrentCallables>
+class ConcurrentCallerTuple {
+ public:
+  explicit ConcurrentCallerTuple(ConcurrentCallables... callables)
+      : data_(std::move(callables)...) {}
+
+  static constexpr std::size_t size() {
+    return sizeof...(ConcurrentCallables);
+  }
+
+  template <class LinearBuffer, class Callback>
+  void call(LinearBuffer& buffer, const Callback& callback) requires
+      (requirements::Callable<ConcurrentCallables,
+                              void,
+                              decltype(buffer.fetch()),
+                              Callback>() && ...) {
+    std::apply([&](ConcurrentCallables&... callables) {
+      (callables(buffer.fetch(), callback), ...);
+    }, data_);
+  }
+
+ private:
+  std::tuple<ConcurrentCallables...> data_;
+};
+
+template <class... ConcurrentCallables>
+auto make_concurrent_caller_tuple(ConcurrentCallables&&... callables) {
+  return ConcurrentCallerTuple<std::decay_t<ConcurrentCallables>...>(
+      std::forward<ConcurrentCallables>(callables)...);
+}
+
+/* Splits the elements into "concurrency" blocks of equal size */
+class StaticPartitioner {
+ public:
+  template <class Portal, class F>
+  void operator()(const Portal& portal, std::size_t size,
+                  std::size_t concurrency, F& task) {
+    ConcurrentCaller1D<decltype(
+        make_concurrent_callable(
+            copy_construct(portal),
+            make_concurrent_procedure(
+                copy_construct(task),
+                std::declval<std::size_t>(),
+                std::declval<std::size_t>())))> caller;
+    std::size_t remainder = size % concurrency,
+                task_size = size / concurrency,
+                first = 0u;
+    for (std::size_t i = 0u; i < remainder; ++i) {
+      caller.emplace(make_concurrent_callable(
+          copy_construct(portal),
+          make_concurrent_procedure(
+            copy_construct(task), copy_construct(first), first + task_size + 1)));
+      first += task_size + 1u;
+    }
+    for (std::size_t i = remainder; i < concurrency; ++i) {
+      caller.emplace(make_concurrent_callable(
+          copy_construct(portal),
+          make_concurrent_procedure(
+            copy_construct(task), copy_construct(first), first + task_size)));
+      first += task_size;
+    }
+    sync_concurrent_invoke([] {}, caller);
+  }
+};
+
+/* Submits "count" workers that run until they find no more elements */
+template <class Portal, class F>
+void concurrent_run_workers(const Portal& portal, std::size_t count,
+                            F& worker) {
+  if (count == 0u) {
+    return;
+  }
+  ConcurrentCaller1D<decltype(
+      make_concurrent_callable(
+          copy_construct(portal),
+          make_concurrent_procedure(copy_construct(worker))))> caller;
+  for (std::size_t i = 0u; i < count; ++i) {
+    caller.emplace(make_concurrent_callable(
+        copy_construct(portal),
+        make_concurrent_procedure(copy_construct(worker))));
+  }
+  sync_concurrent_invoke([] {}, caller);
+}
+
+/* The workers claim chunks of a fixed size from a shared cursor */
+class DynamicPartitioner {
+ public:
+  explicit DynamicPartitioner(std::size_t grain_size = 1u)
+      : grain_size_(std::max<std::size_t>(grain_size, 1u)) {}
+
+  template <class Portal, class F>
+  void operator()(const Portal& portal, std::size_t size,
+                  std::size_t concurrency, F& task) {
+    std::atomic_size_t cursor(0u);
+    auto worker = [&] {
+      for (;;) {
+        std::size_t first = cursor.fetch_add(grain_size_,
+                                             std::memory_order_relaxed);
+        if (first >= size) {
+          break;
+        }
+        task(first, std::min(first + grain_size_, size));
+      }
+    };
+    concurrent_run_workers(
+        portal,
+        std::min(concurrency, (size + grain_size_ - 1u) / grain_size_),
+        worker);
+  }
+
+ private:
+  const std::size_t grain_size_;
+};
+
+/* The chunks shrink with the remaining elements, each worker claims a half
+ * of its share of what is left, but no fewer than "min_grain_size" */
+class GuidedPartitioner {
+ public:
+  explicit GuidedPartitioner(std::size_t min_grain_size = 1u)
+      : min_grain_size_(std::max<std::size_t>(min_grain_size, 1u)) {}
+
+  template <class Portal, class F>
+  void operator()(const Portal& portal, std::size_t size,
+                  std::size_t concurrency, F& task) {
+    std::atomic_size_t cursor(0u);
+    auto worker = [&] {
+      std::size_t first = cursor.load(std::memory_order_relaxed), last;
+      while (first < size) {
+        last = std::min(size, first + std::max(
+            min_grain_size_, (size - first) / (2u * concurrency)));
+        if (cursor.compare_exchange_weak(first, last,
+                                         std::memory_order_relaxed)) {
+          task(first, last);
+          first = cursor.load(std::memory_order_relaxed);
+        }
+      }
+    };
+    concurrent_run_workers(portal, concurrency, worker);
+  }
+
+ private:
+  const std::size_t min_grain_size_;
+};
+
+/* Claims chunks from a shared cursor like DynamicPartitioner, but the chunk
+ * size is picked so that each chunk takes about "target" with the time per
+ * element measured in the previous calls. The number of workers follows the
+ * occupancy of the portal: the workers that found nothing left when they
+ * started were not needed, so one more than the workers that took part in
+ * the last call are submitted. The measurements are not synchronized, so a
+ * caller that owns this partitioner shall not be invoked concurrently. */
+class AutoPartitioner {
+ public:
+  explicit AutoPartitioner(
+      std::chrono::nanoseconds target = std::chrono::microseconds(50))
+      : target_(target), ns_per_element_(0.), workers_(0u) {}
+
+  template <class Portal, class F>
+  void operator()(const Portal& portal, std::size_t size,
+                  std::size_t concurrency, F& task) {
+    std::size_t workers = std::max<std::size_t>(1u, workers_ == 0u
+        ? concurrency : std::min(concurrency, workers_ + 1u));
+    /* Before anything is measured, every worker gets about 8 chunks */
+    std::size_t grain_size = ns_per_element_ == 0.
+        ? size / (workers * 8u)
+        : (std::size_t)(target_.count() / ns_per_element_);
+    grain_size = std::max<std::size_t>(
+        1u, std::min(grain_size, (size + workers - 1u) / workers));
+    std::atomic_size_t cursor(0u), participants(0u);
+    std::atomic<std::chrono::nanoseconds::rep> elapsed(0);
+    auto worker = [&] {
+      auto start = std::chrono::steady_clock::now();
+      bool participated = false;
+      for (;;) {
+        std::size_t first = cursor.fetch_add(grain_size,
+                                             std::memory_order_relaxed);
+        if (first >= size) {
+          break;
+        }
+        participated = true;
+        task(first, std::min(first + grain_size, size));
+      }
+      if (participated) {
+        participants.fetch_add(1u, std::memory_order_relaxed);
+        elapsed.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count(),
+            std::memory_order_relaxed);
+      }
+    };
+    concurrent_run_workers(
+        portal, std::min(workers, (size + grain_size - 1u) / grain_size),
+        worker);
+    if (size != 0u) {
+      double measured = std::max(1., (double)elapsed.load() / size);
+      ns_per_element_ = ns_per_element_ == 0.
+          ? measured : (ns_per_element_ * 3. + measured) / 4.;
+      workers_ = participants.load();
+    }
+  }
+
+ private:
+  const std::chrono::nanoseconds target_;
+  double ns_per_element_;
+  std::size_t workers_;
+};
+
 template <class ExecutionAgentPortal = abstraction::ConcurrentCallablePortal,
           class ConcurrentCallable = abstraction::ConcurrentCallable,
-          class Container = std::vector<ConcurrentCallable>>
+          class Container = std::vector<ConcurrentCallable>,
+          class Partitioner = StaticPartitioner>
 class ConcurrentCaller2D {
  public:
   template <class T>
   explicit ConcurrentCaller2D(
-      T&& portal, std::size_t concurrency = std::thread::hardware_concurrency())
-      : portal_(std::forward<T>(portal)), concurrency_(concurrency) {}
+      T&& portal, std::size_t concurrency = available_concurrency(),
+      const Partitioner& partitioner = Partitioner())
+      : portal_(std::forward<T>(portal)),
+        concurrency_(std::max<std::size_t>(concurrency, 1u)),
+        partitioner_(partitioner) {}
 
   template <class... Args>
   void emplace(Args&&... args) {
+    allocation::Scope scope(allocation::Component::CALLER);
     data_.emplace_back(std::forward<Args>(args)...);
   }
 
@@ -106,6 +335,7 @@ class ConcurrentCaller2D {
                              void,
                              decltype(buffer.fetch()),
                              Callback>() {
+    allocation::Scope scope(allocation::Component::CALLER);
     std::vector<decltype(buffer.fetch())> modifiers;
     modifiers.reserve(data_.size());
     for (std::size_t i = 0; i < data_.size(); ++i) {
@@ -116,37 +346,14 @@ class ConcurrentCaller2D {
         data[i](std::move(modifiers[i]), callback);
       }
     };
-    ConcurrentCaller1D<decltype(
-        make_concurrent_callable(
-            copy_construct(portal_),
-            make_concurrent_procedure(
-                copy_construct(task),
-                std::declval<std::size_t>(),
-                std::declval<std::size_t>())))> caller;
-    std::size_t remainder = data_.size() % concurrency_,
-                task_size = data_.size() / concurrency_,
-                first = 0u;
-    for (std::size_t i = 0u; i < remainder; ++i) {
-      caller.emplace(make_concurrent_callable(
-          copy_construct(portal_),
-          make_concurrent_procedure(
-            copy_construct(task), copy_construct(first), first + task_size + 1)));
-      first += task_size + 1u;
-    }
-    for (std::size_t i = remainder; i < concurrency_; ++i) {
-      caller.emplace(make_concurrent_callable(
-          copy_construct(portal_),
-          make_concurrent_procedure(
-            copy_construct(task), copy_construct(first), first + task_size)));
-      first += task_size;
-    }
-    sync_concurrent_invoke([] {}, caller);
+    partitioner_(portal_, data_.size(), concurrency_, task);
   }
 
  private:
   Container data_;
   ExecutionAgentPortal portal_;
   const std::size_t concurrency_;
+  Partitioner partitioner_;
 };
 
 }
@@ -0,0 +1,177 @@
+/** Copyright (C) 2015-2017 Mingxin Wang - All Rights Reserved.
+ *  This is a C++ header file, which is part of the implementation
+ *  for the Concurrent Support Library.
+ *
+ *  @file     concurrent.h
+ *  @author   Mingxin Wang
+ */
+
+#ifndef _CON_LIB_CONCURRENT_GRAPH
+#define _CON_LIB_CONCURRENT_GRAPH
+
+#include <atomic>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include "core.hpp"
+#include "util.hpp"
+#include "abstraction.hpp"
+#include "allocation.hpp"
+
+namespace con {
+
+/* A task graph meets the ConcurrentCaller requirements, every node joins
+ * once. A node is submitted to its portal as soon as all of its
+ * predecessors have finished. An invocation runs on a snapshot of the nodes,
+ * so that adding nodes or edges, or copying the graph, never touches the
+ * nodes of a running invocation. */
+template <class Portal = abstraction::ConcurrentCallablePortal,
+          class ConcurrentProcedure = abstraction::ConcurrentProcedure>
+class ConcurrentGraph {
+ private:
+  struct Node {
+    template <class T, class U>
+    explicit Node(T&& portal, U&& procedure)
+        : portal_(std::forward<T>(portal)),
+          procedure_(std::forward<U>(procedure)),
+          predecessors_(0u) {}
+
+    Portal portal_;
+    ConcurrentProcedure procedure_;
+    std::vector<std::size_t> successors_;
+    std::size_t predecessors_;
+  };
+
+  template <class AtomicCounterModifier>
+  class Execution {
+   public:
+    explicit Execution(const std::shared_ptr<std::vector<Node>>& nodes)
+        : nodes_(nodes),
+          pending_(new CacheLineStorage<std::atomic_size_t>[nodes->size()]) {
+      modifiers_.reserve(nodes->size());
+      for (std::size_t i = 0u; i < nodes->size(); ++i) {
+        pending_[i].value_.store((*nodes)[i].predecessors_,
+                                 std::memory_order_relaxed);
+      }
+    }
+
+    const std::shared_ptr<std::vector<Node>> nodes_;
+    std::vector<AtomicCounterModifier> modifiers_;
+    const std::unique_ptr<CacheLineStorage<std::atomic_size_t>[]> pending_;
+  };
+
+  template <class AtomicCounterModifier>
+  class Task {
+   public:
+    explicit Task(
+        const std::shared_ptr<Execution<AtomicCounterModifier>>& execution,
+        std::size_t id) : execution_(execution), id_(id) {}
+
+    template <class Modifier, class Callback>
+    void operator()(Modifier&& modifier, Callback&& callback) {
+      Node& node = (*execution_->nodes_)[id_];
+      node.procedure_(modifier, callback);
+      for (std::size_t successor : node.successors_) {
+        if (execution_->pending_[successor].value_.fetch_sub(
+            1u, std::memory_order_acq_rel) == 1u) {
+          submit(execution_, successor, callback);
+        }
+      }
+      concurrent_join(modifier, callback);
+    }
+
+   private:
+    const std::shared_ptr<Execution<AtomicCounterModifier>> execution_;
+    const std::size_t id_;
+  };
+
+ public:
+  ConcurrentGraph() = default;
+
+  /* Returns the id of the new node */
+  template <class T, class U>
+  std::size_t add_node(T&& portal, U&& procedure) {
+    nodes_.emplace_back(std::forward<T>(portal), std::forward<U>(procedure));
+    snapshot_.reset();
+    return nodes_.size() - 1u;
+  }
+
+  /* The node "to" starts after the node "from" has finished. An edge that
+   * closes a cycle is rejected, since the cycle would never be released and
+   * the invocation would never return */
+  void add_edge(std::size_t from, std::size_t to) {
+    if (from >= nodes_.size() || to >= nodes_.size()) {
+      throw std::out_of_range("The edge ends out of the concurrent graph");
+    }
+    if (reaches(to, from)) {
+      throw std::logic_error("The edge closes a cycle in the concurrent graph");
+    }
+    nodes_[from].successors_.push_back(to);
+    ++nodes_[to].predecessors_;
+    snapshot_.reset();
+  }
+
+  std::size_t size() const { return nodes_.size(); }
+
+  template <class LinearBuffer, class Callback>
+  void call(LinearBuffer& buffer, const Callback& callback) {
+    allocation::Scope scope(allocation::Component::CALLER);
+    if (!snapshot_) {
+      snapshot_ = std::make_shared<std::vector<Node>>(nodes_);
+    }
+    auto execution = std::make_shared<
+        Execution<decltype(buffer.fetch())>>(snapshot_);
+    for (std::size_t i = 0u; i < snapshot_->size(); ++i) {
+      execution->modifiers_.emplace_back(buffer.fetch());
+    }
+    for (std::size_t i = 0u; i < snapshot_->size(); ++i) {
+      if ((*snapshot_)[i].predecessors_ == 0u) {
+        submit(execution, i, callback);
+      }
+    }
+  }
+
+ private:
+  template <class AtomicCounterModifier, class Callback>
+  static void submit(
+      const std::shared_ptr<Execution<AtomicCounterModifier>>& execution,
+      std::size_t id, const Callback& callback) {
+    allocation::Scope scope(allocation::Component::TASK);
+    (*execution->nodes_)[id].portal_(
+        Task<AtomicCounterModifier>(execution, id),
+        std::move(execution->modifiers_[id]),
+        copy_construct(callback));
+  }
+
+  /* Returns whether the node "to" is the node "from" or one of its
+   * successors, directly or not */
+  bool reaches(std::size_t from, std::size_t to) const {
+    std::vector<bool> visited(nodes_.size(), false);
+    std::vector<std::size_t> stack{from};
+    visited[from] = true;
+    while (!stack.empty()) {
+      std::size_t current = stack.back();
+      stack.pop_back();
+      if (current == to) {
+        return true;
+      }
+      for (std::size_t successor : nodes_[current].successors_) {
+        if (!visited[successor]) {
+          visited[successor] = true;
+          stack.push_back(successor);
+        }
+      }
+    }
+    return false;
+  }
+
+  std::vector<Node> nodes_;
+
+  /* Shared by the invocations since the last change, rebuilt on demand */
+  std::shared_ptr<std::vector<Node>> snapshot_;
+};
+
+}
+
+#endif // _CON_LIB_CONCURRENT_GRAPH
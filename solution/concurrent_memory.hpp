@@ -0,0 +1,182 @@
+/** Copyright (C) 2015-2017 Mingxin Wang - All Rights Reserved.
+ *  This is a C++ header file, which is part of the implementation
+ *  for the Concurrent Support Library.
+ *
+ *  @file     concurrent.h
+ *  @author   Mingxin Wang
+ */
+
+#ifndef _CON_LIB_CONCURRENT_MEMORY
+#define _CON_LIB_CONCURRENT_MEMORY
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <type_traits>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif // __SSE2__
+
+#include "parallel_algorithm.hpp"
+
+namespace con {
+
+constexpr std::size_t PAGE_SIZE = 4096u;
+
+/* Copies shorter than this run serially on the calling thread */
+constexpr std::size_t MIN_CONCURRENT_MEMORY_SIZE = 1u << 18;
+
+/* Copies longer than this do not fit in the last level cache, and the
+ * destination is written with non-temporal stores */
+constexpr std::size_t NON_TEMPORAL_THRESHOLD = 1u << 25;
+
+inline void stream_memcpy(char* dest, const char* src, std::size_t n) {
+#ifdef __SSE2__
+  std::size_t head = std::min(n, (16u - reinterpret_cast<std::uintptr_t>(dest)
+                                  % 16u) % 16u);
+  std::memcpy(dest, src, head);
+  dest += head;
+  src += head;
+  n -= head;
+  for (; n >= 64u; n -= 64u, dest += 64, src += 64) {
+    __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src)),
+            b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 16)),
+            c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 32)),
+            d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 48));
+    _mm_stream_si128(reinterpret_cast<__m128i*>(dest), a);
+    _mm_stream_si128(reinterpret_cast<__m128i*>(dest + 16), b);
+    _mm_stream_si128(reinterpret_cast<__m128i*>(dest + 32), c);
+    _mm_stream_si128(reinterpret_cast<__m128i*>(dest + 48), d);
+  }
+  std::memcpy(dest, src, n);
+  _mm_sfence();
+#else
+  std::memcpy(dest, src, n);
+#endif // __SSE2__
+}
+
+inline void stream_memset(char* dest, char value, std::size_t n) {
+#ifdef __SSE2__
+  std::size_t head = std::min(n, (16u - reinterpret_cast<std::uintptr_t>(dest)
+                                  % 16u) % 16u);
+  std::memset(dest, value, head);
+  dest += head;
+  n -= head;
+  __m128i v = _mm_set1_epi8(value);
+  for (; n >= 64u; n -= 64u, dest += 64) {
+    _mm_stream_si128(reinterpret_cast<__m128i*>(dest), v);
+    _mm_stream_si128(reinterpret_cast<__m128i*>(dest + 16), v);
+    _mm_stream_si128(reinterpret_cast<__m128i*>(dest + 32), v);
+    _mm_stream_si128(reinterpret_cast<__m128i*>(dest + 48), v);
+  }
+  std::memset(dest, value, n);
+  _mm_sfence();
+#else
+  std::memset(dest, value, n);
+#endif // __SSE2__
+}
+
+/* The ranges shall not overlap, the blocks are aligned to the pages of
+ * the destination */
+template <class Portal>
+void* concurrent_memcpy(
+    const Portal& portal, void* dest, const void* src, std::size_t n,
+    std::size_t concurrency = std::thread::hardware_concurrency()) {
+  char* d = static_cast<char*>(dest);
+  const char* s = static_cast<const char*>(src);
+  BlockPartition partition(n, d, concurrency, PAGE_SIZE,
+                           MIN_CONCURRENT_MEMORY_SIZE);
+  bool non_temporal = n >= NON_TEMPORAL_THRESHOLD;
+  auto task = [&](std::size_t i) {
+    std::size_t first = partition.bound(i), last = partition.bound(i + 1u);
+    if (non_temporal) {
+      stream_memcpy(d + first, s + first, last - first);
+    } else {
+      std::memcpy(d + first, s + first, last - first);
+    }
+  };
+  concurrent_dispatch(portal, partition.size(), task);
+  return dest;
+}
+
+/* Overlapping ranges are moved in rounds, each round copies a window no
+ * longer than the distance between the ranges, so that no block reads
+ * the bytes written by another one */
+template <class Portal>
+void* concurrent_memmove(
+    const Portal& portal, void* dest, const void* src, std::size_t n,
+    std::size_t concurrency = std::thread::hardware_concurrency()) {
+  char* d = static_cast<char*>(dest);
+  const char* s = static_cast<const char*>(src);
+  std::size_t distance = d < s ? s - d : d - s;
+  if (distance >= n) {
+    return concurrent_memcpy(portal, dest, src, n, concurrency);
+  }
+  if (distance < MIN_CONCURRENT_MEMORY_SIZE) {
+    return std::memmove(dest, src, n);
+  }
+  for (std::size_t done = 0u; done < n; done += distance) {
+    std::size_t window = std::min(distance, n - done),
+                offset = d < s ? done : n - done - window;
+    concurrent_memcpy(portal, d + offset, s + offset, window, concurrency);
+  }
+  return dest;
+}
+
+/* Trivially copyable objects are copied as bytes. The source is deduced on
+ * its own, so that a source of "T*" as well as "const T*" is more
+ * specialized than the iterators of the generic concurrent_copy */
+template <class Portal, class U, class T>
+T* concurrent_copy(
+    const Portal& portal, U* first, U* last, T* d_first,
+    std::size_t concurrency = std::thread::hardware_concurrency()) requires
+    std::is_same<std::remove_const_t<U>, T>::value &&
+    std::is_trivially_copyable<T>::value {
+  concurrent_memmove(portal, d_first, first, (last - first) * sizeof(T),
+                     concurrency);
+  return d_first + (last - first);
+}
+
+template <class Portal, class ForwardIt, class T>
+void concurrent_fill(
+    const Portal& portal, ForwardIt first, ForwardIt last, const T& value,
+    std::size_t concurrency = std::thread::hardware_concurrency()) {
+  using U = typename std::iterator_traits<ForwardIt>::value_type;
+  BlockPartition partition(last - first, first, concurrency, PAGE_SIZE,
+                           MIN_CONCURRENT_MEMORY_SIZE / sizeof(U));
+  auto task = [&](std::size_t i) {
+    std::fill(first + partition.bound(i), first + partition.bound(i + 1u),
+              value);
+  };
+  concurrent_dispatch(portal, partition.size(), task);
+}
+
+/* Single bytes are filled with memset, or with non-temporal stores */
+template <class Portal, class T>
+void concurrent_fill(
+    const Portal& portal, T* first, T* last, const T& value,
+    std::size_t concurrency = std::thread::hardware_concurrency()) requires
+    (sizeof(T) == 1u) && std::is_trivially_copyable<T>::value {
+  char* d = reinterpret_cast<char*>(first);
+  char byte;
+  std::memcpy(&byte, &value, 1u);
+  std::size_t n = last - first;
+  BlockPartition partition(n, d, concurrency, PAGE_SIZE,
+                           MIN_CONCURRENT_MEMORY_SIZE);
+  bool non_temporal = n >= NON_TEMPORAL_THRESHOLD;
+  auto task = [&](std::size_t i) {
+    std::size_t begin = partition.bound(i), end = partition.bound(i + 1u);
+    if (non_temporal) {
+      stream_memset(d + begin, byte, end - begin);
+    } else {
+      std::memset(d + begin, byte, end - begin);
+    }
+  };
+  concurrent_dispatch(portal, partition.size(), task);
+}
+
+}
+
+#endif // _CON_LIB_CONCURRENT_MEMORY
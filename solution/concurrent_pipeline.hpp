@@ -0,0 +1,197 @@
+/** Copyright (C) 2015-2017 Mingxin Wang - All Rights Reserved.
+ *  This is a C++ header file, which is part of the implementation
+ *  for the Concurrent Support Library.
+ *
+ *  @file     concurrent.h
+ *  @author   Mingxin Wang
+ */
+
+#ifndef _CON_LIB_CONCURRENT_PIPELINE
+#define _CON_LIB_CONCURRENT_PIPELINE
+
+#include <atomic>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "core.hpp"
+#include "util.hpp"
+#include "allocation.hpp"
+#include "channel.hpp"
+
+namespace con {
+
+template <class Portal, class F>
+struct PipelineStage {
+  template <class T, class U>
+  explicit PipelineStage(T&& portal, U&& f, std::size_t concurrency,
+                         std::size_t batch_size)
+      : portal_(std::forward<T>(portal)), f_(std::forward<U>(f)),
+        concurrency_(concurrency), batch_size_(batch_size) {}
+
+  Portal portal_;
+  F f_;
+  const std::size_t concurrency_;
+  const std::size_t batch_size_;
+};
+
+template <class Portal, class F>
+auto make_pipeline_stage(Portal&& portal, F&& f, std::size_t concurrency = 1u,
+                         std::size_t batch_size = 1u) {
+  return PipelineStage<std::decay_t<Portal>, std::decay_t<F>>(
+      std::forward<Portal>(portal), std::forward<F>(f),
+      concurrency, batch_size);
+}
+
+template <class T, class... Stages>
+class PipelineNode;
+
+template <class T>
+class PipelineNode<T> {
+ public:
+  explicit PipelineNode(std::size_t) {}
+
+  constexpr std::size_t size() const { return 0u; }
+
+  template <class LinearBuffer, class Callback>
+  void launch(const std::shared_ptr<void>&, LinearBuffer&, const Callback&) {}
+
+  void close() {}
+};
+
+/* Owns the input channel of a stage and every stage after it. The workers
+ * park on blocking semaphores rather than help the pool, for a helping worker
+ * would run the other workers on top of its own one, and a worker that waits
+ * for those would never be woken. */
+template <class T, class Portal, class F, class... OtherStages>
+class PipelineNode<T, PipelineStage<Portal, F>, OtherStages...> {
+ private:
+  using Output = std::decay_t<decltype(std::declval<F&>()(std::declval<T>()))>;
+
+ public:
+  template <class U, class... V>
+  explicit PipelineNode(std::size_t capacity, U&& stage, V&&... other_stages)
+      : channel_(capacity),
+        stage_(std::forward<U>(stage)),
+        running_(stage_.concurrency_),
+        next_(capacity, std::forward<V>(other_stages)...) {}
+
+  std::size_t size() const { return stage_.concurrency_ + next_.size(); }
+
+  /* Parks the producer while the channel is full */
+  template <class U>
+  void push(U&& value) {
+    channel_.template send<BlockingBinarySemaphore>(std::forward<U>(value));
+  }
+
+  void close() { channel_.close(); }
+
+  template <class LinearBuffer, class Callback>
+  void launch(const std::shared_ptr<void>& keeper, LinearBuffer& buffer,
+              const Callback& callback) {
+    for (std::size_t i = 0u; i < stage_.concurrency_; ++i) {
+      stage_.portal_([this, keeper](auto&& modifier, auto&& callback) {
+                       work();
+                       concurrent_join(modifier, callback);
+                     },
+                     buffer.fetch(),
+                     copy_construct(callback));
+    }
+    next_.launch(keeper, buffer, callback);
+  }
+
+ private:
+  /* Parks the worker while the channel is empty, until it is closed and
+   * drained */
+  void work() {
+    std::vector<T> batch;
+    {
+      allocation::Scope scope(allocation::Component::CALLER);
+      batch.reserve(stage_.batch_size_);
+    }
+    while (channel_.template receive_batch<BlockingBinarySemaphore>(
+        std::back_inserter(batch), stage_.batch_size_) != 0u) {
+      for (T& value : batch) {
+        deliver(std::move(value));
+      }
+      batch.clear();
+    }
+    if (running_.fetch_sub(1u, std::memory_order_acq_rel) == 1u) {
+      next_.close();
+    }
+  }
+
+  void deliver(T&& value) {
+    if constexpr (sizeof...(OtherStages) == 0u) {
+      stage_.f_(std::move(value));
+    } else {
+      next_.push(stage_.f_(std::move(value)));
+    }
+  }
+
+  Channel<T> channel_;
+  PipelineStage<Portal, F> stage_;
+  std::atomic_size_t running_;
+  PipelineNode<Output, OtherStages...> next_;
+};
+
+/* Meets the ConcurrentCaller requirements, and each worker of each stage
+ * joins once. Every stage shall be able to run all of its workers at the
+ * same time, otherwise a blocked producer may never be drained. The items
+ * are kept in the cells of lock-free queues, so they shall be default
+ * constructible and move assignable. A pipeline is invoked once, for its
+ * channels stay closed after the last item, and copies share the invocation:
+ * another call throws std::logic_error. */
+template <class T, class... Stages>
+class ConcurrentPipeline {
+ public:
+  template <class... U>
+  explicit ConcurrentPipeline(std::size_t capacity, U&&... stages)
+      : state_(make_state(capacity, std::forward<U>(stages)...)) {}
+
+  std::size_t size() const { return state_->head_.size(); }
+
+  template <class LinearBuffer, class Callback>
+  void call(LinearBuffer& buffer, const Callback& callback) {
+    if (state_->launched_.exchange(true, std::memory_order_relaxed)) {
+      throw std::logic_error("The concurrent pipeline has been invoked");
+    }
+    state_->head_.launch(state_, buffer, callback);
+  }
+
+  template <class U>
+  void push(U&& value) { state_->head_.push(std::forward<U>(value)); }
+
+  void close() { state_->head_.close(); }
+
+ private:
+  struct State {
+    template <class... U>
+    explicit State(std::size_t capacity, U&&... stages)
+        : head_(capacity, std::forward<U>(stages)...), launched_(false) {}
+
+    PipelineNode<T, Stages...> head_;
+    std::atomic_bool launched_;
+  };
+
+  template <class... U>
+  static auto make_state(std::size_t capacity, U&&... stages) {
+    allocation::Scope scope(allocation::Component::CALLER);
+    return std::make_shared<State>(capacity, std::forward<U>(stages)...);
+  }
+
+  std::shared_ptr<State> state_;
+};
+
+template <class T, class... Stages>
+auto make_concurrent_pipeline(std::size_t capacity, Stages&&... stages) {
+  return ConcurrentPipeline<T, std::decay_t<Stages>...>(
+      capacity, std::forward<Stages>(stages)...);
+}
+
+}
+
+#endif // _CON_LIB_CONCURRENT_PIPELINE
@@ -0,0 +1,154 @@
+/** Copyright (C) 2015-2017 Mingxin Wang - All Rights Reserved.
+ *  This is a C++ header file, which is part of the implementation
+ *  for the Concurrent Support Library.
+ *
+ *  @file     concurrent.h
+ *  @author   Mingxin Wang
+ */
+
+#ifndef _CON_LIB_CONCURRENT_RESULT
+#define _CON_LIB_CONCURRENT_RESULT
+
+#include <functional>
+#include <memory>
+#include <type_traits>
+
+#include "core.hpp"
+#include "util.hpp"
+#include "concurrent_procedure.hpp"
+#include "concurrent_callable.hpp"
+#include "concurrent_caller.hpp"
+#include "allocation.hpp"
+
+namespace con {
+
+/* Preallocated output slots indexed by task, each slot occupies whole cache
+ * lines so that the tasks do not false share */
+template <class T>
+class ConcurrentResultBuffer {
+ public:
+  explicit ConcurrentResultBuffer(std::size_t size)
+      : size_(size), data_(new CacheLineStorage<T>[size]) {}
+
+  ConcurrentResultBuffer(ConcurrentResultBuffer&&) = default;
+
+  std::size_t size() const { return size_; }
+
+  T& operator[](std::size_t i) { return data_[i].value_; }
+
+  const T& operator[](std::size_t i) const { return data_[i].value_; }
+
+ private:
+  std::size_t size_;
+  std::unique_ptr<CacheLineStorage<T>[]> data_;
+};
+
+/* Combines the slots into the first one when the last join fires, then
+ * calls the wrapped callback */
+template <class T, class BinaryOperation, class Callback>
+class GatherConcurrentCallback {
+ public:
+  explicit GatherConcurrentCallback(ConcurrentResultBuffer<T>& results,
+                                    BinaryOperation& combine,
+                                    const Callback& callback)
+      : results_(&results), combine_(&combine), callback_(callback) {}
+
+  GatherConcurrentCallback(const GatherConcurrentCallback&) = default;
+
+  GatherConcurrentCallback& operator=(const GatherConcurrentCallback&) = default;
+
+  void operator()() const {
+    ConcurrentResultBuffer<T>& results = *results_;
+    for (std::size_t i = 1u; i < results.size(); ++i) {
+      results[0u] = (*combine_)(std::move(results[0u]), std::move(results[i]));
+    }
+    callback_();
+  }
+
+ private:
+  ConcurrentResultBuffer<T>* results_;
+  BinaryOperation* combine_;
+  Callback callback_;
+};
+
+template <class Portal, class F>
+auto make_gather_concurrent_caller(
+    const Portal& portal, std::size_t count, F& f,
+    ConcurrentResultBuffer<std::decay_t<decltype(f(0u))>>& results) {
+  allocation::Scope scope(allocation::Component::CALLER);
+  auto task = [&f, &results](std::size_t i) { results[i] = f(i); };
+  auto make_callable = [&](std::size_t i) {
+    return make_concurrent_callable(
+        copy_construct(portal),
+        make_concurrent_procedure(copy_construct(task), i));
+  };
+  ConcurrentCaller1D<decltype(make_callable(0u))> caller;
+  for (std::size_t i = 0u; i < count; ++i) {
+    caller.emplace(make_callable(i));
+  }
+  return caller;
+}
+
+/* Calls f(i) for every i in [0, count) with the portal, and returns the
+ * values in the order of the tasks */
+template <class Portal, class F>
+auto sync_concurrent_invoke_gather(const Portal& portal, std::size_t count,
+                                   F&& f) {
+  ConcurrentResultBuffer<std::decay_t<decltype(f(0u))>> results(count);
+  if (count != 0u) {
+    auto caller = make_gather_concurrent_caller(portal, count, f, results);
+    sync_concurrent_invoke([] {}, caller);
+  }
+  return results;
+}
+
+/* The values are combined in the order of the tasks by the execution agent
+ * that makes the last join, the operation shall be associative. A default
+ * constructed value is returned when "count" is 0. */
+template <class AtomicCounterInitializer,
+          class BinarySemaphore,
+          class Portal,
+          class F,
+          class BinaryOperation>
+auto sync_concurrent_invoke_gather_explicit(
+    AtomicCounterInitializer&& initializer,
+    BinarySemaphore&& semaphore,
+    const Portal& portal,
+    std::size_t count,
+    F&& f,
+    BinaryOperation&& combine) requires
+    requirements::AtomicCounterInitializer<AtomicCounterInitializer>() &&
+    requirements::BinarySemaphore<BinarySemaphore>() {
+  using T = std::decay_t<decltype(f(0u))>;
+  using Callback = SyncConcurrentCallback<std::remove_reference_t<BinarySemaphore>>;
+  ConcurrentResultBuffer<T> results(count);
+  if (count == 0u) {
+    return T();
+  }
+  auto caller = make_gather_concurrent_caller(portal, count, f, results);
+  async_concurrent_invoke_explicit(
+      initializer,
+      GatherConcurrentCallback<T, std::remove_reference_t<BinaryOperation>, Callback>(
+          results, combine, Callback(semaphore)),
+      caller);
+  {
+    SyncInvokeHelper<std::remove_reference_t<BinarySemaphore>> blocker(semaphore);
+  }
+  return std::move(results[0u]);
+}
+
+template <class Portal, class F, class BinaryOperation>
+auto sync_concurrent_invoke_gather(const Portal& portal, std::size_t count,
+                                   F&& f, BinaryOperation&& combine) {
+  return sync_concurrent_invoke_gather_explicit(
+      DefaultAtomicCounterInitializer(),
+      DefaultBinarySemaphore(),
+      portal,
+      count,
+      f,
+      combine);
+}
+
+}
+
+#endif // _CON_LIB_CONCURRENT_RESULT
@@ -12,9 +12,11 @@
 #include <cstddef>
 #include <functional>
 
+#include "util.hpp"
 #include "atomic_counter.hpp"
 #include "binary_semaphore.hpp"
 #include "requirements.hpp"
+#include "trace.hpp"
 
 namespace con {
 
@@ -22,13 +24,21 @@ using DefaultAtomicCounterInitializer = BasicAtomicCounter::Initializer;
 using DefaultBinarySemaphore = DisposableBinarySemaphore;
 
 template <class ConcurrentCaller>
-inline std::size_t count_call(const ConcurrentCaller& caller) {
+constexpr std::size_t count_call(const ConcurrentCaller& caller) {
   return caller.size();
 }
 
+/* The size is a property of the type, so the object is never read, and the
+ * count is a constant expression */
+template <class ConcurrentCaller>
+constexpr std::size_t count_call(const ConcurrentCaller&) requires
+    requirements::StaticConcurrentCaller<ConcurrentCaller>() {
+  return ConcurrentCaller::size();
+}
+
 template <class FirstConcurrentCaller,
           class... OtherConcurrentCallers>
-inline std::size_t count_call(
+constexpr std::size_t count_call(
     const FirstConcurrentCaller& first_caller,
     const OtherConcurrentCallers&... other_callers) {
   return count_call(first_caller) + count_call(other_callers...);
@@ -99,7 +109,11 @@ class SyncInvokeHelper {
   explicit SyncInvokeHelper(BinarySemaphore& semaphore)
       : semaphore_(semaphore) {}
 
-  ~SyncInvokeHelper() { semaphore_.wait(); }
+  ~SyncInvokeHelper() {
+    trace::wait_begin();
+    semaphore_.wait();
+    trace::wait_end();
+  }
 
  private:
   BinarySemaphore& semaphore_;
@@ -145,6 +159,57 @@ void async_concurrent_invoke(const Callback& callback,
                                    callers...);
 }
 
+/* Submits the callback to a portal when the last join fires, so that the
+ * continuation does not occupy the execution agent that made the join */
+template <class Portal, class Callback>
+class PortalConcurrentCallback {
+ public:
+  explicit PortalConcurrentCallback(const Portal& portal,
+                                    const Callback& callback)
+      : portal_(portal), callback_(callback) {}
+
+  PortalConcurrentCallback(const PortalConcurrentCallback&) = default;
+
+  PortalConcurrentCallback& operator=(const PortalConcurrentCallback&) = default;
+
+  void operator()() const {
+    portal_(copy_construct(callback_));
+  }
+
+ private:
+  mutable Portal portal_;
+  Callback callback_;
+};
+
+template <class AtomicCounterInitializer,
+          class Portal,
+          class Callback,
+          class... ConcurrentCallers>
+void async_concurrent_invoke_on_explicit(AtomicCounterInitializer&& initializer,
+                                         const Portal& portal,
+                                         const Callback& callback,
+                                         ConcurrentCallers&&... callers) requires
+    requirements::Callable<Portal, void, Callback>() {
+  async_concurrent_invoke_explicit(
+      initializer,
+      PortalConcurrentCallback<Portal, Callback>(portal, callback),
+      callers...);
+}
+
+/* The callback runs on the portal instead of the execution agent that makes
+ * the last join */
+template <class Portal,
+          class Callback,
+          class... ConcurrentCallers>
+void async_concurrent_invoke_on(const Portal& portal,
+                                const Callback& callback,
+                                ConcurrentCallers&&... callers) {
+  async_concurrent_invoke_on_explicit(DefaultAtomicCounterInitializer(),
+                                      portal,
+                                      callback,
+                                      callers...);
+}
+
 template <class AtomicCounterModifier,
           class Callback,
           class... ConcurrentCallers>
@@ -168,6 +233,7 @@ void concurrent_join(AtomicCounterModifier& modifier,
                      Callback& callback) requires
     requirements::AtomicCounterModifier<AtomicCounterModifier>() &&
     requirements::Callable<Callback, void>() {
+  trace::join();
   if (!modifier.decrement()) {
     callback();
   }
@@ -0,0 +1,224 @@
+/** Copyright (C) 2015-2017 Mingxin Wang - All Rights Reserved.
+ *  This is a C++ header file, which is part of the implementation
+ *  for the Concurrent Support Library.
+ *
+ *  @file     concurrent.h
+ *  @author   Mingxin Wang
+ */
+
+#ifndef _CON_LIB_LOCK_FREE_QUEUE
+#define _CON_LIB_LOCK_FREE_QUEUE
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+#include "util.hpp"
+
+namespace con {
+
+inline std::size_t round_up_capacity(std::size_t capacity) {
+  std::size_t res = 2u;
+  while (res < capacity) {
+    res <<= 1;
+  }
+  return res;
+}
+
+/* A bounded MPMC queue, each cell is guarded by a sequence number */
+template <class T>
+class LockFreeBoundedQueue {
+ public:
+  explicit LockFreeBoundedQueue(std::size_t capacity)
+      : mask_(round_up_capacity(capacity) - 1u),
+        cells_(new Cell[mask_ + 1u]),
+        enqueue_pos_(0u),
+        dequeue_pos_(0u) {
+    for (std::size_t i = 0u; i <= mask_; ++i) {
+      cells_[i].sequence_.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  LockFreeBoundedQueue(const LockFreeBoundedQueue&) = delete;
+
+  std::size_t capacity() const { return mask_ + 1u; }
+
+  /* The value is not moved from unless the operation succeeds */
+  template <class U>
+  bool try_push(U&& value) {
+    Cell* cell;
+    std::size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+    for (;;) {
+      cell = &cells_[pos & mask_];
+      std::size_t seq = cell->sequence_.load(std::memory_order_acquire);
+      std::ptrdiff_t diff = (std::ptrdiff_t)seq - (std::ptrdiff_t)pos;
+      if (diff == 0) {
+        if (enqueue_pos_.compare_exchange_weak(
+            pos, pos + 1u, std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = enqueue_pos_.load(std::memory_order_relaxed);
+      }
+    }
+    cell->data_ = std::forward<U>(value);
+    cell->sequence_.store(pos + 1u, std::memory_order_release);
+    return true;
+  }
+
+  bool try_pop(T& value) {
+    Cell* cell;
+    std::size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+    for (;;) {
+      cell = &cells_[pos & mask_];
+      std::size_t seq = cell->sequence_.load(std::memory_order_acquire);
+      std::ptrdiff_t diff = (std::ptrdiff_t)seq - (std::ptrdiff_t)(pos + 1u);
+      if (diff == 0) {
+        if (dequeue_pos_.compare_exchange_weak(
+            pos, pos + 1u, std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = dequeue_pos_.load(std::memory_order_relaxed);
+      }
+    }
+    value = std::move(cell->data_);
+    cell->sequence_.store(pos + mask_ + 1u, std::memory_order_release);
+    return true;
+  }
+
+ private:
+  struct Cell {
+    std::atomic_size_t sequence_;
+    T data_;
+  };
+
+  const std::size_t mask_;
+  const std::unique_ptr<Cell[]> cells_;
+  alignas(CACHE_LINE_SIZE) std::atomic_size_t enqueue_pos_;
+  alignas(CACHE_LINE_SIZE) std::atomic_size_t dequeue_pos_;
+};
+
+/* A bounded queue for one producer and one consumer. Each side keeps a copy
+ * of the index of the other side, and only reloads it when the copy says
+ * the queue is full or empty, so that the two sides rarely touch the same
+ * cache line. */
+template <class T>
+class LockFreeSpscQueue {
+ public:
+  explicit LockFreeSpscQueue(std::size_t capacity)
+      : mask_(round_up_capacity(capacity) - 1u),
+        cells_(new T[mask_ + 1u]),
+        tail_(0u),
+        cached_head_(0u),
+        head_(0u),
+        cached_tail_(0u) {}
+
+  LockFreeSpscQueue(const LockFreeSpscQueue&) = delete;
+
+  std::size_t capacity() const { return mask_ + 1u; }
+
+  /* The value is not moved from unless the operation succeeds */
+  template <class U>
+  bool try_push(U&& value) {
+    std::size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail - cached_head_ > mask_) {
+      cached_head_ = head_.load(std::memory_order_acquire);
+      if (tail - cached_head_ > mask_) {
+        return false;
+      }
+    }
+    cells_[tail & mask_] = std::forward<U>(value);
+    tail_.store(tail + 1u, std::memory_order_release);
+    return true;
+  }
+
+  bool try_pop(T& value) {
+    std::size_t head = head_.load(std::memory_order_relaxed);
+    if (head == cached_tail_) {
+      cached_tail_ = tail_.load(std::memory_order_acquire);
+      if (head == cached_tail_) {
+        return false;
+      }
+    }
+    value = std::move(cells_[head & mask_]);
+    head_.store(head + 1u, std::memory_order_release);
+    return true;
+  }
+
+ private:
+  const std::size_t mask_;
+  const std::unique_ptr<T[]> cells_;
+  alignas(CACHE_LINE_SIZE) std::atomic_size_t tail_;
+  std::size_t cached_head_;
+  alignas(CACHE_LINE_SIZE) std::atomic_size_t head_;
+  std::size_t cached_tail_;
+};
+
+/* An unbounded queue for one producer and one consumer, made of segments
+ * that the producer links and the consumer frees once it has left them */
+template <class T, std::size_t SEGMENT_SIZE = 256u>
+class LockFreeUnboundedSpscQueue {
+ public:
+  explicit LockFreeUnboundedSpscQueue(std::size_t = 0u)
+      : tail_segment_(new Segment()), tail_(0u),
+        head_segment_(tail_segment_), head_(0u) {}
+
+  LockFreeUnboundedSpscQueue(const LockFreeUnboundedSpscQueue&) = delete;
+
+  ~LockFreeUnboundedSpscQueue() {
+    while (head_segment_ != nullptr) {
+      Segment* next = head_segment_->next_;
+      delete head_segment_;
+      head_segment_ = next;
+    }
+  }
+
+  template <class U>
+  bool try_push(U&& value) {
+    std::size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail != 0u && tail % SEGMENT_SIZE == 0u) {
+      /* Published to the consumer by the store of the tail below */
+      tail_segment_->next_ = new Segment();
+      tail_segment_ = tail_segment_->next_;
+    }
+    tail_segment_->cells_[tail % SEGMENT_SIZE] = std::forward<U>(value);
+    tail_.store(tail + 1u, std::memory_order_release);
+    return true;
+  }
+
+  bool try_pop(T& value) {
+    if (head_ == tail_.load(std::memory_order_acquire)) {
+      return false;
+    }
+    if (head_ != 0u && head_ % SEGMENT_SIZE == 0u) {
+      Segment* next = head_segment_->next_;
+      delete head_segment_;
+      head_segment_ = next;
+    }
+    value = std::move(head_segment_->cells_[head_++ % SEGMENT_SIZE]);
+    return true;
+  }
+
+ private:
+  struct Segment {
+    Segment() : next_(nullptr) {}
+
+    T cells_[SEGMENT_SIZE];
+    Segment* next_;
+  };
+
+  Segment* tail_segment_;
+  alignas(CACHE_LINE_SIZE) std::atomic_size_t tail_;
+  alignas(CACHE_LINE_SIZE) Segment* head_segment_;
+  std::size_t head_;
+};
+
+}
+
+#endif // _CON_LIB_LOCK_FREE_QUEUE
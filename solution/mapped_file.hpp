@@ -0,0 +1,197 @@
+/** Copyright (C) 2015-2017 Mingxin Wang - All Rights Reserved.
+ *  This is a C++ header file, which is part of the implementation
+ *  for the Concurrent Support Library.
+ *
+ *  @file     concurrent.h
+ *  @author   Mingxin Wang
+ */
+
+#ifndef _CON_LIB_MAPPED_FILE
+#define _CON_LIB_MAPPED_FILE
+
+#ifdef __unix__
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "requirements.hpp"
+#include "util.hpp"
+#include "allocation.hpp"
+#include "concurrent_callable.hpp"
+
+namespace con {
+
+/* A read-only private mapping of a whole file, advised for sequential
+ * access so that the kernel reads ahead of every chunk being scanned */
+class MappedFile {
+ public:
+  explicit MappedFile(const std::string& path)
+      : data_(nullptr), size_(0u) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+      throw std::system_error(errno, std::system_category());
+    }
+    struct stat status;
+    if (fstat(fd, &status) == -1) {
+      int error = errno;
+      close(fd);
+      throw std::system_error(error, std::system_category());
+    }
+    size_ = (std::size_t)status.st_size;
+    if (size_ != 0u) {
+      void* data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (data == MAP_FAILED) {
+        int error = errno;
+        close(fd);
+        throw std::system_error(error, std::system_category());
+      }
+      data_ = static_cast<const char*>(data);
+      madvise(data, size_, MADV_SEQUENTIAL);
+    }
+    /* The mapping stays valid after the descriptor is closed */
+    close(fd);
+  }
+
+  MappedFile(const MappedFile&) = delete;
+
+  ~MappedFile() {
+    if (data_ != nullptr) {
+      munmap(const_cast<char*>(data_), size_);
+    }
+  }
+
+  std::string_view view() const { return std::string_view(data_, size_); }
+
+  std::size_t size() const { return size_; }
+
+ private:
+  const char* data_;
+  std::size_t size_;
+};
+
+/* Calls f with every chunk of the file as a string_view, each chunk is a
+ * task of the portal. The chunks start at page boundaries moved forward to
+ * the next record, so that every record is in exactly one chunk, and a chunk
+ * finds its own boundaries when it runs, so that no chunk allocates anything
+ * but what the portal needs to submit it. The tasks share what they need
+ * with the caller, so that the caller may be a temporary, but the file shall
+ * live until the invoke is joined, and f shall be safe to call
+ * concurrently. */
+template <class Portal, class F>
+class MappedFileCaller {
+ private:
+  struct State {
+    template <class U>
+    explicit State(std::string_view data, U&& f, std::size_t chunks,
+                   char delimiter)
+        : data_(data),
+          f_(std::forward<U>(f)),
+          page_size_((std::size_t)sysconf(_SC_PAGESIZE)),
+          count_(std::max<std::size_t>(
+              std::min(chunks, (data.size() + page_size_ - 1u) / page_size_),
+              1u)),
+          delimiter_(delimiter) {}
+
+    std::string_view chunk(std::size_t i) const {
+      std::size_t first = boundary(i), last = boundary(i + 1u);
+      return data_.substr(first, last - first);
+    }
+
+    /* The first record starting at or after the i-th page-aligned offset */
+    std::size_t boundary(std::size_t i) const {
+      if (i == 0u) {
+        return 0u;
+      }
+      if (i >= count_) {
+        return data_.size();
+      }
+      std::size_t pages = (data_.size() + page_size_ - 1u) / page_size_;
+      std::size_t offset = pages * i / count_ * page_size_;
+      const void* found = std::memchr(data_.data() + offset - 1u, delimiter_,
+                                      data_.size() - offset + 1u);
+      return found == nullptr ? data_.size()
+          : (std::size_t)(static_cast<const char*>(found) - data_.data()) + 1u;
+    }
+
+    const std::string_view data_;
+    mutable F f_;
+    const std::size_t page_size_;
+    const std::size_t count_;
+    const char delimiter_;
+  };
+
+  class Procedure {
+   public:
+    explicit Procedure(const std::shared_ptr<const State>& state,
+                       std::size_t index)
+        : state_(state), index_(index) {}
+
+    template <class AtomicCounterModifier, class Callback>
+    void operator()(AtomicCounterModifier&&, Callback&&) const {
+      std::string_view chunk = state_->chunk(index_);
+      if (!chunk.empty()) {
+        state_->f_(chunk);
+      }
+    }
+
+   private:
+    std::shared_ptr<const State> state_;
+    std::size_t index_;
+  };
+
+ public:
+  template <class T, class U>
+  explicit MappedFileCaller(
+      const MappedFile& file, T&& portal, U&& f,
+      std::size_t chunks = std::thread::hardware_concurrency(),
+      char delimiter = '\n')
+      : portal_(std::forward<T>(portal)) {
+    allocation::Scope scope(allocation::Component::CALLER);
+    state_ = std::make_shared<const State>(file.view(), std::forward<U>(f),
+                                           chunks, delimiter);
+  }
+
+  std::size_t size() const { return state_->count_; }
+
+  template <class LinearBuffer, class Callback>
+  void call(LinearBuffer& buffer, const Callback& callback) {
+    for (std::size_t i = 0u; i < state_->count_; ++i) {
+      make_concurrent_callable(copy_construct(portal_), Procedure(state_, i))(
+          buffer.fetch(), callback);
+    }
+  }
+
+  std::string_view chunk(std::size_t i) const { return state_->chunk(i); }
+
+ private:
+  Portal portal_;
+  std::shared_ptr<const State> state_;
+};
+
+template <class Portal, class F>
+auto make_mapped_file_caller(
+    const MappedFile& file, Portal&& portal, F&& f,
+    std::size_t chunks = std::thread::hardware_concurrency(),
+    char delimiter = '\n') requires
+    requirements::Callable<F, void, std::string_view>() {
+  return MappedFileCaller<std::decay_t<Portal>, std::decay_t<F>>(
+      file, std::forward<Portal>(portal), std::forward<F>(f), chunks,
+      delimiter);
+}
+
+}
+
+#endif // __unix__
+
+#endif // _CON_LIB_MAPPED_FILE
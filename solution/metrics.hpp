@@ -0,0 +1,196 @@
+/** Copyright (C) 2015-2017 Mingxin Wang - All Rights Reserved.
+ *  This is a C++ header file, which is part of the implementation
+ *  for the Concurrent Support Library.
+ *
+ *  @file     concurrent.h
+ *  @author   Mingxin Wang
+ */
+
+#ifndef _CON_LIB_METRICS
+#define _CON_LIB_METRICS
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <thread>
+#include <vector>
+
+#include "util.hpp"
+
+namespace con {
+
+/* Bucket 0 counts the zeros, and bucket i counts the values in
+ * [2 ^ (i - 1), 2 ^ i) */
+constexpr std::size_t HISTOGRAM_BUCKETS = 65u;
+
+inline std::uint64_t steady_clock_ns() {
+  return (std::uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/* Only one thread may write a counter at a time, so that a load and a store
+ * are enough and the readers see a value that is at most slightly stale */
+inline void increment(std::atomic<std::uint64_t>& counter,
+                      std::uint64_t delta = 1u) {
+  counter.store(counter.load(std::memory_order_relaxed) + delta,
+                std::memory_order_relaxed);
+}
+
+struct Histogram {
+  Histogram() : buckets_{}, sum_(0u) {}
+
+  std::uint64_t count() const {
+    std::uint64_t result = 0u;
+    for (std::uint64_t bucket : buckets_) {
+      result += bucket;
+    }
+    return result;
+  }
+
+  double mean() const {
+    std::uint64_t total = count();
+    return total == 0u ? 0. : (double)sum_ / total;
+  }
+
+  /* Returns the upper bound of the bucket where the quantile lies */
+  std::uint64_t quantile(double p) const {
+    std::uint64_t total = count(), seen = 0u;
+    for (std::size_t i = 0u; i < HISTOGRAM_BUCKETS; ++i) {
+      seen += buckets_[i];
+      if (seen > 0u && seen >= p * total) {
+        return i == 0u ? 0u : i == HISTOGRAM_BUCKETS - 1u
+            ? std::numeric_limits<std::uint64_t>::max()
+            : (std::uint64_t(1u) << i) - 1u;
+      }
+    }
+    return 0u;
+  }
+
+  Histogram& operator+=(const Histogram& rhs) {
+    for (std::size_t i = 0u; i < HISTOGRAM_BUCKETS; ++i) {
+      buckets_[i] += rhs.buckets_[i];
+    }
+    sum_ += rhs.sum_;
+    return *this;
+  }
+
+  std::array<std::uint64_t, HISTOGRAM_BUCKETS> buckets_;
+  std::uint64_t sum_;
+};
+
+class AtomicHistogram {
+ public:
+  AtomicHistogram() : buckets_{}, sum_(0u) {}
+
+  void record(std::uint64_t value) {
+    std::size_t i = 0u;
+    for (std::uint64_t v = value; v != 0u; v >>= 1) {
+      ++i;
+    }
+    increment(buckets_[i]);
+    increment(sum_, value);
+  }
+
+  Histogram load() const {
+    Histogram result;
+    for (std::size_t i = 0u; i < HISTOGRAM_BUCKETS; ++i) {
+      result.buckets_[i] = buckets_[i].load(std::memory_order_relaxed);
+    }
+    result.sum_ = sum_.load(std::memory_order_relaxed);
+    return result;
+  }
+
+ private:
+  std::array<std::atomic<std::uint64_t>, HISTOGRAM_BUCKETS> buckets_;
+  std::atomic<std::uint64_t> sum_;
+};
+
+struct ThreadPoolWorkerMetrics {
+  ThreadPoolWorkerMetrics()
+      : tasks_(0u), lock_failures_(0u), empty_wakeups_(0u), idle_ns_(0u),
+        continued_(0u) {}
+
+  ThreadPoolWorkerMetrics& operator+=(const ThreadPoolWorkerMetrics& rhs) {
+    tasks_ += rhs.tasks_;
+    lock_failures_ += rhs.lock_failures_;
+    empty_wakeups_ += rhs.empty_wakeups_;
+    idle_ns_ += rhs.idle_ns_;
+    continued_ += rhs.continued_;
+    queue_wait_ns_ += rhs.queue_wait_ns_;
+    run_time_ns_ += rhs.run_time_ns_;
+    return *this;
+  }
+
+  std::uint64_t tasks_;
+  /* try_lock failures on the pool mutex */
+  std::uint64_t lock_failures_;
+  /* Wakeups that found neither a task nor a shutdown */
+  std::uint64_t empty_wakeups_;
+  /* Time spent waiting on the condition variable */
+  std::uint64_t idle_ns_;
+  /* Phases run by the worker that ran the previous phase, without queueing */
+  std::uint64_t continued_;
+  Histogram queue_wait_ns_;
+  Histogram run_time_ns_;
+};
+
+/* The counters are always kept. The times, which cost clock reads on every
+ * task, are measured only while the timing of the pool is enabled, and are
+ * 0 otherwise. */
+struct ThreadPoolMetrics {
+  ThreadPoolMetrics()
+      : timed_(false), submitted_(0u), submit_lock_failures_(0u) {}
+
+  ThreadPoolWorkerMetrics total() const {
+    ThreadPoolWorkerMetrics result;
+    for (const ThreadPoolWorkerMetrics& worker : workers_) {
+      result += worker;
+    }
+    return result;
+  }
+
+  /* Whether the times are measured when the snapshot is taken */
+  bool timed_;
+  std::uint64_t submitted_;
+  std::uint64_t submit_lock_failures_;
+  /* Tasks already queued when a task is submitted */
+  Histogram queue_depth_;
+  std::vector<ThreadPoolWorkerMetrics> workers_;
+};
+
+/* Written only by the worker that owns it */
+class alignas(CACHE_LINE_SIZE) ThreadPoolWorkerCounters {
+ public:
+  ThreadPoolWorkerCounters()
+      : tasks_(0u), lock_failures_(0u), empty_wakeups_(0u), idle_ns_(0u),
+        continued_(0u) {}
+
+  ThreadPoolWorkerMetrics load() const {
+    ThreadPoolWorkerMetrics result;
+    result.tasks_ = tasks_.load(std::memory_order_relaxed);
+    result.lock_failures_ = lock_failures_.load(std::memory_order_relaxed);
+    result.empty_wakeups_ = empty_wakeups_.load(std::memory_order_relaxed);
+    result.idle_ns_ = idle_ns_.load(std::memory_order_relaxed);
+    result.continued_ = continued_.load(std::memory_order_relaxed);
+    result.queue_wait_ns_ = queue_wait_ns_.load();
+    result.run_time_ns_ = run_time_ns_.load();
+    return result;
+  }
+
+  std::atomic<std::uint64_t> tasks_;
+  std::atomic<std::uint64_t> lock_failures_;
+  std::atomic<std::uint64_t> empty_wakeups_;
+  std::atomic<std::uint64_t> idle_ns_;
+  std::atomic<std::uint64_t> continued_;
+  AtomicHistogram queue_wait_ns_;
+  AtomicHistogram run_time_ns_;
+  /* The thread of the worker, which may run the pool more than once */
+  std::thread::id thread_;
+};
+
+}
+
+#endif // _CON_LIB_METRICS
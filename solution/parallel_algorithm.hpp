@@ -0,0 +1,220 @@
+/** Copyright (C) 2015-2017 Mingxin Wang - All Rights Reserved.
+ *  This is a C++ header file, which is part of the implementation
+ *  for the Concurrent Support Library.
+ *
+ *  @file     concurrent.h
+ *  @author   Mingxin Wang
+ */
+
+#ifndef _CON_LIB_PARALLEL_ALGORITHM
+#define _CON_LIB_PARALLEL_ALGORITHM
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <numeric>
+#include <thread>
+#include <vector>
+
+#include "core.hpp"
+#include "util.hpp"
+#include "concurrent_procedure.hpp"
+#include "concurrent_callable.hpp"
+#include "concurrent_caller.hpp"
+
+namespace con {
+
+/* Ranges shorter than this are not worth an extra execution agent */
+constexpr std::size_t MIN_BLOCK_SIZE = 4096u;
+
+/* Splits [0, n) into at most "concurrency" blocks of at least
+ * "min_block_size" elements. The inner boundaries are aligned to
+ * "alignment" bytes of the anchor range, by default to its cache lines, so
+ * that no two blocks write to the same cache line. */
+class BlockPartition {
+ public:
+  template <class Iterator>
+  explicit BlockPartition(std::size_t n, const Iterator& anchor,
+                          std::size_t concurrency,
+                          std::size_t alignment = CACHE_LINE_SIZE,
+                          std::size_t min_block_size = MIN_BLOCK_SIZE)
+      : n_(n), skew_(0u), block_size_(1u), count_(0u) {
+    if (n == 0u) {
+      return;
+    }
+    using T = typename std::iterator_traits<Iterator>::value_type;
+    std::size_t line = std::max<std::size_t>(1u, alignment / sizeof(T)),
+                gap = (alignment - reinterpret_cast<std::uintptr_t>(
+                    std::addressof(*anchor)) % alignment) % alignment;
+    skew_ = gap % sizeof(T) == 0u ? gap / sizeof(T) % line : 0u;
+    block_size_ = std::max(min_block_size,
+                           (n - 1u) / std::max<std::size_t>(concurrency, 1u) + 1u);
+    block_size_ = (block_size_ + line - 1u) / line * line;
+    count_ = n <= skew_ ? 1u : (n - skew_ - 1u) / block_size_ + 1u;
+  }
+
+  std::size_t size() const { return count_; }
+
+  /* The first index of the i-th block, bound(size()) == n */
+  std::size_t bound(std::size_t i) const {
+    return i == 0u ? 0u : std::min(n_, skew_ + i * block_size_);
+  }
+
+ private:
+  const std::size_t n_;
+  std::size_t skew_, block_size_, count_;
+};
+
+/* Calls f(i) for every i in [0, count) with the portal, and the calling
+ * thread takes f(0) while the others are running */
+template <class Portal, class F>
+void concurrent_dispatch(const Portal& portal, std::size_t count, F& f) {
+  if (count <= 1u) {
+    if (count == 1u) {
+      f(0u);
+    }
+    return;
+  }
+  auto make_callable = [&](std::size_t i) {
+    return make_concurrent_callable(
+        copy_construct(portal),
+        make_concurrent_procedure(std::ref(f), i));
+  };
+  ConcurrentCaller1D<decltype(make_callable(0u))> caller;
+  for (std::size_t i = 1u; i < count; ++i) {
+    caller.emplace(make_callable(i));
+  }
+  sync_concurrent_invoke([&] { f(0u); }, caller);
+}
+
+template <class Portal, class RandomIt, class UnaryFunction>
+void concurrent_for_each(
+    const Portal& portal, RandomIt first, RandomIt last, UnaryFunction f,
+    std::size_t concurrency = std::thread::hardware_concurrency()) {
+  BlockPartition partition(last - first, first, concurrency);
+  auto task = [&](std::size_t i) {
+    std::for_each(first + partition.bound(i), first + partition.bound(i + 1u), f);
+  };
+  concurrent_dispatch(portal, partition.size(), task);
+}
+
+template <class Portal, class RandomIt1, class RandomIt2, class UnaryOperation>
+RandomIt2 concurrent_transform(
+    const Portal& portal, RandomIt1 first, RandomIt1 last, RandomIt2 d_first,
+    UnaryOperation op,
+    std::size_t concurrency = std::thread::hardware_concurrency()) {
+  BlockPartition partition(last - first, d_first, concurrency);
+  auto task = [&](std::size_t i) {
+    std::transform(first + partition.bound(i), first + partition.bound(i + 1u),
+                   d_first + partition.bound(i), op);
+  };
+  concurrent_dispatch(portal, partition.size(), task);
+  return d_first + (last - first);
+}
+
+template <class Portal, class RandomIt1, class RandomIt2>
+RandomIt2 concurrent_copy(
+    const Portal& portal, RandomIt1 first, RandomIt1 last, RandomIt2 d_first,
+    std::size_t concurrency = std::thread::hardware_concurrency()) {
+  BlockPartition partition(last - first, d_first, concurrency);
+  auto task = [&](std::size_t i) {
+    std::copy(first + partition.bound(i), first + partition.bound(i + 1u),
+              d_first + partition.bound(i));
+  };
+  concurrent_dispatch(portal, partition.size(), task);
+  return d_first + (last - first);
+}
+
+/* The operation shall be associative, the blocks are combined in order */
+template <class Portal, class RandomIt, class T, class BinaryOperation = std::plus<>>
+T concurrent_reduce(
+    const Portal& portal, RandomIt first, RandomIt last, T init,
+    BinaryOperation op = BinaryOperation(),
+    std::size_t concurrency = std::thread::hardware_concurrency()) {
+  BlockPartition partition(last - first, first, concurrency);
+  std::vector<CacheLineStorage<T>> partial(partition.size(),
+                                           CacheLineStorage<T>{init});
+  auto task = [&](std::size_t i) {
+    RandomIt begin = first + partition.bound(i);
+    partial[i].value_ = std::accumulate(
+        begin + 1, first + partition.bound(i + 1u), T(*begin), op);
+  };
+  concurrent_dispatch(portal, partition.size(), task);
+  for (auto& storage : partial) {
+    init = op(std::move(init), std::move(storage.value_));
+  }
+  return init;
+}
+
+/* Reduces every block but the first, then scans the blocks with the
+ * combined prefix of the blocks before them */
+template <class Portal, class RandomIt1, class RandomIt2,
+          class BinaryOperation = std::plus<>>
+RandomIt2 concurrent_inclusive_scan(
+    const Portal& portal, RandomIt1 first, RandomIt1 last, RandomIt2 d_first,
+    BinaryOperation op = BinaryOperation(),
+    std::size_t concurrency = std::thread::hardware_concurrency()) {
+  using T = typename std::iterator_traits<RandomIt1>::value_type;
+  BlockPartition partition(last - first, d_first, concurrency);
+  if (partition.size() <= 1u) {
+    return std::partial_sum(first, last, d_first, op);
+  }
+  std::vector<CacheLineStorage<T>> prefix(partition.size(),
+                                          CacheLineStorage<T>{*first});
+  auto reduce_task = [&](std::size_t i) {
+    RandomIt1 begin = first + partition.bound(i),
+              end = first + partition.bound(i + 1u);
+    if (i == 0u) {
+      std::partial_sum(begin, end, d_first, op);
+    } else {
+      prefix[i].value_ = std::accumulate(begin + 1, end, T(*begin), op);
+    }
+  };
+  concurrent_dispatch(portal, partition.size() - 1u, reduce_task);
+  prefix[0u].value_ = *(d_first + (partition.bound(1u) - 1u));
+  for (std::size_t i = 1u; i + 1u < partition.size(); ++i) {
+    prefix[i].value_ = op(prefix[i - 1u].value_, prefix[i].value_);
+  }
+  auto scan_task = [&](std::size_t i) {
+    T running = prefix[i].value_;
+    RandomIt2 out = d_first + partition.bound(i + 1u);
+    for (RandomIt1 it = first + partition.bound(i + 1u),
+                   end = first + partition.bound(i + 2u); it != end; ++it) {
+      running = op(std::move(running), *it);
+      *out++ = running;
+    }
+  };
+  concurrent_dispatch(portal, partition.size() - 1u, scan_task);
+  return d_first + (last - first);
+}
+
+/* Sorts the blocks concurrently, then merges them pairwise in rounds */
+template <class Portal, class RandomIt, class Compare = std::less<>>
+void concurrent_sort(
+    const Portal& portal, RandomIt first, RandomIt last,
+    Compare comp = Compare(),
+    std::size_t concurrency = std::thread::hardware_concurrency()) {
+  BlockPartition partition(last - first, first, concurrency);
+  std::size_t count = partition.size();
+  auto sort_task = [&](std::size_t i) {
+    std::sort(first + partition.bound(i), first + partition.bound(i + 1u), comp);
+  };
+  concurrent_dispatch(portal, count, sort_task);
+  for (std::size_t width = 1u; width < count; width *= 2u) {
+    auto merge_task = [&](std::size_t i) {
+      std::size_t lo = 2u * width * i, mid = lo + width,
+                  hi = std::min(mid + width, count);
+      std::inplace_merge(first + partition.bound(lo),
+                         first + partition.bound(mid),
+                         first + partition.bound(hi), comp);
+    };
+    concurrent_dispatch(portal, (count - width + 2u * width - 1u) / (2u * width),
+                        merge_task);
+  }
+}
+
+}
+
+#endif // _CON_LIB_PARALLEL_ALGORITHM
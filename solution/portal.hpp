@@ -9,14 +9,20 @@
 #ifndef _CON_LIB_PORTAL
 #define _CON_LIB_PORTAL
 
+#include <atomic>
 #include <thread>
 #include <condition_variable>
+#include <deque>
 #include <mutex>
 #include <queue>
 #include <functional>
 #include <memory>
 
 #include "requirements.hpp"
+#include "metrics.hpp"
+#include "trace.hpp"
+#include "allocation.hpp"
+#include "binary_semaphore.hpp"
 
 namespace con {
 
@@ -38,41 +44,113 @@ class ThreadPortal<true> {
   template <class F, class... Args>
   void operator()(F&& f, Args&&... args) const requires
       requirements::Callable<F, void, Args...>() {
-    std::thread(std::forward<F>(f), std::forward<Args>(args)...).detach();
+    allocation::Scope scope(allocation::Component::PORTAL);
+    std::thread(trace::wrap(std::forward<F>(f)), std::forward<Args>(args)...)
+        .detach();
   }
 };
 
+/* Keeps the non-daemon threads joinable until they finish. Each thread marks
+ * itself done when its task returns, and the finished threads are joined by
+ * the later submissions, so that a long-running program does not keep the
+ * handle of every thread it has created. The registry is a lock-free stack
+ * that is only ever detached as a whole, and the rest of the threads are
+ * joined at exit. */
 class ThreadManager {
+ private:
+  struct Entry {
+    Entry() : done_(false), next_(nullptr) {}
+
+    std::thread thread_;
+    std::atomic_bool done_;
+    Entry* next_;
+  };
+
  public:
+  /* The finished threads are reaped once there are this many of them */
+  static constexpr std::size_t REAP_THRESHOLD = 32u;
+
   ~ThreadManager() {
-    mtx_.lock();
-    while (!threads_.empty()) {
-      std::deque<std::thread> threads = std::move(threads_);
-      mtx_.unlock();
+    Entry* entries;
+    while ((entries = head_.exchange(nullptr, std::memory_order_acquire))
+        != nullptr) {
       do {
-        threads.back().join();
-        threads.pop_back();
-      } while (!threads.empty());
-      mtx_.lock();
+        Entry* next = entries->next_;
+        entries->thread_.join();
+        delete entries;
+        entries = next;
+      } while (entries != nullptr);
     }
-    mtx_.unlock();
   }
 
-  void emplace(std::thread&& th) {
-    std::lock_guard<std::mutex> lk(mtx_);
-    threads_.emplace_back(std::forward<std::thread>(th));
+  template <class F, class... Args>
+  void emplace(F&& f, Args&&... args) {
+    reap();
+    Entry* entry = new Entry();
+    entry->thread_ = std::thread(
+        [this, entry](std::decay_t<F> f, std::decay_t<Args>... args) {
+          f(std::move(args)...);
+          finished_.fetch_add(1u, std::memory_order_relaxed);
+          entry->done_.store(true, std::memory_order_release);
+        }, std::forward<F>(f), std::forward<Args>(args)...);
+    size_.fetch_add(1u, std::memory_order_relaxed);
+    push(entry, entry);
   }
 
+  /* The number of threads that are not reaped yet */
+  std::size_t size() const { return size_.load(std::memory_order_relaxed); }
+
   static ThreadManager& instance() {
     static ThreadManager manager;
     return manager;
   }
 
  private:
-  explicit ThreadManager() = default;
+  explicit ThreadManager() : head_(nullptr), size_(0u), finished_(0u) {
+    reaping_.clear(std::memory_order_relaxed);
+  }
 
-  std::mutex mtx_;
-  std::deque<std::thread> threads_;
+  void push(Entry* first, Entry* last) {
+    last->next_ = head_.load(std::memory_order_relaxed);
+    while (!head_.compare_exchange_weak(last->next_, first,
+                                        std::memory_order_release,
+                                        std::memory_order_relaxed)) {}
+  }
+
+  /* Only one submission reaps at a time, and the others do not wait for it */
+  void reap() {
+    if (finished_.load(std::memory_order_relaxed) < REAP_THRESHOLD ||
+        reaping_.test_and_set(std::memory_order_acquire)) {
+      return;
+    }
+    Entry* entries = head_.exchange(nullptr, std::memory_order_acquire);
+    Entry *alive_first = nullptr, *alive_last = nullptr;
+    while (entries != nullptr) {
+      Entry* next = entries->next_;
+      if (entries->done_.load(std::memory_order_acquire)) {
+        entries->thread_.join();
+        delete entries;
+        finished_.fetch_sub(1u, std::memory_order_relaxed);
+        size_.fetch_sub(1u, std::memory_order_relaxed);
+      } else {
+        entries->next_ = alive_first;
+        if (alive_last == nullptr) {
+          alive_last = entries;
+        }
+        alive_first = entries;
+      }
+      entries = next;
+    }
+    if (alive_first != nullptr) {
+      push(alive_first, alive_last);
+    }
+    reaping_.clear(std::memory_order_release);
+  }
+
+  std::atomic<Entry*> head_;
+  std::atomic_size_t size_;
+  std::atomic_size_t finished_;
+  std::atomic_flag reaping_;
 };
 
 template <>
@@ -81,32 +159,147 @@ class ThreadPortal<false> {
   template <class F, class... Args>
   void operator()(F&& f, Args&&... args) const requires
       requirements::Callable<F, void, Args...>() {
-    ThreadManager::instance().emplace(
-        std::thread(std::forward<F>(f), std::forward<Args>(args)...));
+    allocation::Scope scope(allocation::Component::PORTAL);
+    ThreadManager::instance().emplace(trace::wrap(std::forward<F>(f)),
+                                      std::forward<Args>(args)...);
   }
 };
 
+/* The counters of the pool worker running on this thread, if any */
+inline ThreadPoolWorkerCounters*& current_pool_worker() {
+  static thread_local ThreadPoolWorkerCounters* worker = nullptr;
+  return worker;
+}
+
+/* Whether the task running on this thread is submitting its next phase,
+ * and how many phases are already continued on this thread's stack */
+struct PhaseHandoff {
+  bool pending_;
+  std::size_t depth_;
+};
+
+constexpr std::size_t MAX_CONTINUED_PHASES = 16u;
+
+/* A worker that waits for a synchronous invocation runs the other tasks, up
+ * to this many waits nested on its stack. A deeper one blocks, and a new
+ * thread works for the pool in its place until it resumes. */
+constexpr std::size_t MAX_HELPING_DEPTH = 16u;
+
+inline std::size_t& current_helping_depth() {
+  static thread_local std::size_t depth = 0u;
+  return depth;
+}
+
+inline PhaseHandoff& current_phase_handoff() {
+  static thread_local PhaseHandoff handoff = {false, 0u};
+  return handoff;
+}
+
+/* Marks the submissions in the scope as the next phase of the task running
+ * on this thread, or as anything else if "pending" is false */
+class PhaseHandoffScope {
+ public:
+  explicit PhaseHandoffScope(bool pending = true)
+      : previous_(current_phase_handoff().pending_) {
+    current_phase_handoff().pending_ = pending;
+  }
+
+  PhaseHandoffScope(const PhaseHandoffScope&) = delete;
+
+  ~PhaseHandoffScope() { current_phase_handoff().pending_ = previous_; }
+
+ private:
+  const bool previous_;
+};
+
+/* Runs a continued phase one level deeper, with the hint cleared */
+class ContinuedPhaseScope {
+ public:
+  ContinuedPhaseScope() : handoff_(false) { ++current_phase_handoff().depth_; }
+
+  ContinuedPhaseScope(const ContinuedPhaseScope&) = delete;
+
+  ~ContinuedPhaseScope() { --current_phase_handoff().depth_; }
+
+ private:
+  PhaseHandoffScope handoff_;
+};
+
+/* Remembers when the task was submitted, and records the queue wait time to
+ * the worker that runs it, while the timing of the pool is enabled */
+template <class F>
+class QueuedTask {
+ public:
+  explicit QueuedTask(F&& f)
+      : f_(std::forward<F>(f)), submitted_(steady_clock_ns()) {}
+
+  void operator()() {
+    ThreadPoolWorkerCounters* worker = current_pool_worker();
+    if (worker != nullptr) {
+      worker->queue_wait_ns_.record(steady_clock_ns() - submitted_);
+    }
+    f_();
+  }
+
+ private:
+  std::decay_t<F> f_;
+  std::uint64_t submitted_;
+};
+
 template <class Task, class Queue>
 requires requirements::Runnable<Task>()
-class ThreadPool {
+class ThreadPool
+    : public TaskExecutor,
+      public std::enable_shared_from_this<ThreadPool<Task, Queue>> {
  public:
-  explicit ThreadPool() : is_shutdown_(false) {}
+  explicit ThreadPool()
+      : is_shutdown_(false),
+        idle_(0u),
+        helpers_(nullptr),
+        timed_(false),
+        submitted_(0u),
+        submit_lock_failures_(0u) {}
 
   void execute() {
     std::unique_lock<std::mutex> lk(mtx_);
-    for (;;) {
-      while (!tasks_.empty()) {
-        Task current = std::move(tasks_.front());
-        tasks_.pop();
-        mtx_.unlock();
-        current();
-        mtx_.lock();
-      }
-      if (is_shutdown_) {
-        break;
+    ThreadPoolWorkerCounters* previous_worker = current_pool_worker();
+    TaskExecutor* previous_executor = current_task_executor();
+    current_pool_worker() = &local_worker();
+    current_task_executor() = this;
+    run(lk, nullptr, cond_);
+    current_pool_worker() = previous_worker;
+    current_task_executor() = previous_executor;
+  }
+
+  /* Called by a worker of this pool in a task */
+  void run_until(const std::atomic_bool& done,
+                 std::condition_variable& cond) override {
+    std::unique_lock<std::mutex> lk(mtx_);
+    std::size_t& depth = current_helping_depth();
+    if (depth >= MAX_HELPING_DEPTH) {
+      std::shared_ptr<Compensation> compensation;
+      {
+        allocation::Scope scope(allocation::Component::PORTAL);
+        compensation = std::make_shared<Compensation>();
       }
-      cond_.wait(lk);
+      ThreadPortal<false>()([pool = this->shared_from_this(), compensation] {
+        pool->compensate(*compensation);
+      });
+      cond.wait(lk, [&] { return done.load(std::memory_order_relaxed); });
+      compensation->done_.store(true, std::memory_order_relaxed);
+      compensation->cond_.notify_one();
+      return;
     }
+    ++depth;
+    run(lk, &done, cond);
+    --depth;
+  }
+
+  void release(std::atomic_bool& done,
+               std::condition_variable& cond) override {
+    std::lock_guard<std::mutex> lk(mtx_);
+    done.store(true, std::memory_order_relaxed);
+    cond.notify_one();
   }
 
   void shutdown() {
@@ -117,20 +310,194 @@ class ThreadPool {
     cond_.notify_all();
   }
 
+  /* Runs the next phase of the task on the worker that ran the previous one
+   * instead of queueing it behind the other tasks, so that it finds the data
+   * of that phase in the caches of the same core. The worker would take
+   * another task from the queue otherwise, so no worker is kept idle, and
+   * the depth is bounded so that a long chain of phases is queued again. */
+  template <class F>
+  bool try_continue(F& f) {
+    PhaseHandoff& handoff = current_phase_handoff();
+    if (!handoff.pending_ || handoff.depth_ >= MAX_CONTINUED_PHASES ||
+        current_task_executor() != this) {
+      return false;
+    }
+    increment(current_pool_worker()->continued_);
+    ContinuedPhaseScope continued;
+    allocation::Scope scope(allocation::Component::USER);
+    f();
+    return true;
+  }
+
+  /* An idle worker is woken for the task, or a waiting helper if there is
+   * none */
   template <class... Args>
   void emplace(Args&&... args) {
     {
-      std::lock_guard<std::mutex> lk(mtx_);
-      tasks_.emplace(std::forward<Args>(args)...);
+      lock(submit_lock_failures_);
+      std::lock_guard<std::mutex> lk(mtx_, std::adopt_lock);
+      queue_depth_.record(tasks_.size());
+      if (timed_.load(std::memory_order_relaxed)) {
+        tasks_.emplace(QueuedTask<Task>(Task(std::forward<Args>(args)...)));
+      } else {
+        tasks_.emplace(std::forward<Args>(args)...);
+      }
+      increment(submitted_);
+      if (idle_ == 0u && helpers_ != nullptr) {
+        helpers_->cond_->notify_one();
+        return;
+      }
     }
     cond_.notify_one();
   }
 
+  /* The counters of the workers are read without stopping them, so that the
+   * snapshot may be slightly stale */
+  /* Enables or disables the measuring of the queue wait, run and idle times
+   * of the tasks submitted and run from now on */
+  void set_timed(bool timed) {
+    timed_.store(timed, std::memory_order_relaxed);
+  }
+
+  ThreadPoolMetrics metrics() {
+    ThreadPoolMetrics result;
+    std::lock_guard<std::mutex> lk(mtx_);
+    result.timed_ = timed_.load(std::memory_order_relaxed);
+    result.submitted_ = submitted_.load(std::memory_order_relaxed);
+    result.submit_lock_failures_ =
+        submit_lock_failures_.load(std::memory_order_relaxed);
+    result.queue_depth_ = queue_depth_.load();
+    for (const ThreadPoolWorkerCounters& worker : workers_) {
+      result.workers_.push_back(worker.load());
+    }
+    return result;
+  }
+
  private:
+  /* Set when the blocked worker that a thread works in place of resumes */
+  struct Compensation {
+    Compensation() : done_(false) {}
+
+    std::atomic_bool done_;
+    std::condition_variable cond_;
+  };
+
+  void compensate(Compensation& compensation) {
+    std::unique_lock<std::mutex> lk(mtx_);
+    ThreadPoolWorkerCounters* previous_worker = current_pool_worker();
+    TaskExecutor* previous_executor = current_task_executor();
+    current_pool_worker() = &local_worker();
+    current_task_executor() = this;
+    run(lk, &compensation.done_, compensation.cond_);
+    current_pool_worker() = previous_worker;
+    current_task_executor() = previous_executor;
+  }
+
+  /* A worker that waits for a synchronous invocation in run_until() */
+  struct Helper {
+    std::condition_variable* cond_;
+    Helper* prev_;
+    Helper* next_;
+  };
+
+  /* Runs the tasks until "done" is set, or until the pool is shut down and
+   * drained if "done" is null, and waits on "cond" while there is none */
+  void run(std::unique_lock<std::mutex>& lk, const std::atomic_bool* done,
+           std::condition_variable& cond) {
+    ThreadPoolWorkerCounters& worker = *current_pool_worker();
+    while (done == nullptr || !done->load(std::memory_order_relaxed)) {
+      if (!tasks_.empty()) {
+        /* The task is destroyed before locking, for it may own the last
+         * reference to this pool */
+        {
+          Task current = std::move(tasks_.front());
+          tasks_.pop();
+          mtx_.unlock();
+          if (timed_.load(std::memory_order_relaxed)) {
+            std::uint64_t start = steady_clock_ns();
+            current();
+            worker.run_time_ns_.record(steady_clock_ns() - start);
+          } else {
+            current();
+          }
+          increment(worker.tasks_);
+        }
+        lock(worker.lock_failures_);
+      } else if (done == nullptr && is_shutdown_) {
+        break;
+      } else {
+        if (timed_.load(std::memory_order_relaxed)) {
+          std::uint64_t idle_start = steady_clock_ns();
+          wait(lk, cond);
+          increment(worker.idle_ns_, steady_clock_ns() - idle_start);
+        } else {
+          wait(lk, cond);
+        }
+        if (tasks_.empty() && !is_shutdown_ &&
+            (done == nullptr || !done->load(std::memory_order_relaxed))) {
+          increment(worker.empty_wakeups_);
+        }
+      }
+    }
+  }
+
+  /* The idle workers wait on the condition variable of the pool, and every
+   * helper on its own, so that a release wakes the helper alone */
+  void wait(std::unique_lock<std::mutex>& lk, std::condition_variable& cond) {
+    if (&cond == &cond_) {
+      ++idle_;
+      cond_.wait(lk);
+      --idle_;
+      return;
+    }
+    Helper helper{&cond, nullptr, helpers_};
+    if (helpers_ != nullptr) {
+      helpers_->prev_ = &helper;
+    }
+    helpers_ = &helper;
+    cond.wait(lk);
+    if (helper.prev_ != nullptr) {
+      helper.prev_->next_ = helper.next_;
+    } else {
+      helpers_ = helper.next_;
+    }
+    if (helper.next_ != nullptr) {
+      helper.next_->prev_ = helper.prev_;
+    }
+  }
+
+  void lock(std::atomic<std::uint64_t>& failures) {
+    if (!mtx_.try_lock()) {
+      failures.fetch_add(1u, std::memory_order_relaxed);
+      mtx_.lock();
+    }
+  }
+
+  /* The counters of the calling thread are added the first time it runs the
+   * pool, so that running an event loop again does not add more */
+  ThreadPoolWorkerCounters& local_worker() {
+    std::thread::id self = std::this_thread::get_id();
+    for (ThreadPoolWorkerCounters& worker : workers_) {
+      if (worker.thread_ == self) {
+        return worker;
+      }
+    }
+    workers_.emplace_back();
+    workers_.back().thread_ = self;
+    return workers_.back();
+  }
+
   std::mutex mtx_;
   std::condition_variable cond_;
   bool is_shutdown_;
+  std::size_t idle_;
+  Helper* helpers_;
+  std::atomic_bool timed_;
   Queue tasks_;
+  std::deque<ThreadPoolWorkerCounters> workers_;
+  std::atomic<std::uint64_t> submitted_;
+  std::atomic<std::uint64_t> submit_lock_failures_;
+  AtomicHistogram queue_depth_;
 };
 
 template <class Task = abstraction::Runnable,
@@ -152,16 +519,56 @@ class ThreadPoolPortal {
 
   ~ThreadPoolPortal() { if ((bool)pool_) pool_->shutdown(); }
 
+  ThreadPoolMetrics metrics() const { return pool_->metrics(); }
+
+  void set_timed(bool timed) const { pool_->set_timed(timed); }
+
   template <class F, class... Args>
   void operator()(F&& f, Args&&... args) const requires
       requirements::Callable<F, void, Args...>() {
-    pool_->emplace(bind_simple(std::forward<F>(f), std::forward<Args>(args)...));
+    allocation::Scope scope(allocation::Component::PORTAL);
+    auto task = bind_simple(trace::wrap(std::forward<F>(f)),
+                            std::forward<Args>(args)...);
+    if (!pool_->try_continue(task)) {
+      pool_->emplace(std::move(task));
+    }
   }
 
  private:
   std::shared_ptr<ThreadPool<Task, Queue>> pool_;
 };
 
+/* Tasks submitted to the portal run on the thread that calls run(), and the
+ * copies of the portal share the same loop */
+template <class Task = abstraction::Runnable,
+          class Queue = std::queue<Task>>
+class EventLoopPortal {
+ public:
+  explicit EventLoopPortal()
+      : loop_(std::make_shared<ThreadPool<Task, Queue>>()) {}
+
+  EventLoopPortal(const EventLoopPortal&) = default;
+
+  EventLoopPortal& operator=(const EventLoopPortal&) = default;
+
+  template <class F, class... Args>
+  void operator()(F&& f, Args&&... args) const requires
+      requirements::Callable<F, void, Args...>() {
+    allocation::Scope scope(allocation::Component::PORTAL);
+    loop_->emplace(bind_simple(trace::wrap(std::forward<F>(f)),
+                               std::forward<Args>(args)...));
+  }
+
+  /* Runs the tasks on the calling thread until stop() is called, the tasks
+   * submitted before that are drained */
+  void run() const { loop_->execute(); }
+
+  void stop() const { loop_->shutdown(); }
+
+ private:
+  std::shared_ptr<ThreadPool<Task, Queue>> loop_;
+};
+
 }
 
 #endif // _CON_LIB_PORTAL
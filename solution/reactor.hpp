@@ -0,0 +1,275 @@
+/** Copyright (C) 2015-2017 Mingxin Wang - All Rights Reserved.
+ *  This is a C++ header file, which is part of the implementation
+ *  for the Concurrent Support Library.
+ *
+ *  @file     concurrent.h
+ *  @author   Mingxin Wang
+ */
+
+#ifndef _CON_LIB_REACTOR
+#define _CON_LIB_REACTOR
+
+#ifdef __linux__
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <system_error>
+#include <tuple>
+#include <utility>
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include "requirements.hpp"
+#include "allocation.hpp"
+#include "abstraction.hpp"
+#include "portal.hpp"
+
+namespace con {
+
+/* Waits for the file descriptors with epoll on the thread that calls
+ * execute(), and runs the task of a watch once its file descriptor is ready.
+ * A watch fires only once, and a file descriptor may have only one watch at a
+ * time. The reactor is woken up with an eventfd to shut down, and it fires the
+ * pending watches at once before it exits, so that no file descriptor that is
+ * never ready keeps it, or the invoke of the task, waiting. */
+template <class Task = abstraction::Runnable>
+requires requirements::Runnable<Task>()
+class Reactor {
+ public:
+  static constexpr int MAX_EVENTS = 64;
+
+  explicit Reactor()
+      : epoll_fd_(epoll_create1(EPOLL_CLOEXEC)),
+        event_fd_(eventfd(0u, EFD_CLOEXEC | EFD_NONBLOCK)),
+        pending_(0u),
+        is_shutdown_(false),
+        is_closed_(false),
+        head_(nullptr) {
+    if (epoll_fd_ == -1 || event_fd_ == -1) {
+      int error = errno;
+      close_all();
+      throw std::system_error(error, std::system_category());
+    }
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.ptr = nullptr;
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, event_fd_, &event) == -1) {
+      int error = errno;
+      close_all();
+      throw std::system_error(error, std::system_category());
+    }
+  }
+
+  Reactor(const Reactor&) = delete;
+
+  ~Reactor() { close_all(); }
+
+  void execute() {
+    epoll_event events[MAX_EVENTS];
+    while (!is_shutdown_.load(std::memory_order_acquire)) {
+      int n = epoll_wait(epoll_fd_, events, MAX_EVENTS, -1);
+      for (int i = 0; i < n; ++i) {
+        Watch* watch = static_cast<Watch*>(events[i].data.ptr);
+        if (watch == nullptr) {
+          std::uint64_t value;
+          if (read(event_fd_, &value, sizeof(value)) == -1) {}
+          continue;
+        }
+        {
+          std::lock_guard<std::mutex> lk(mtx_);
+          unlink(*watch);
+        }
+        fire(watch);
+      }
+    }
+    Watch* pending;
+    {
+      std::lock_guard<std::mutex> lk(mtx_);
+      is_closed_ = true;
+      pending = head_;
+      head_ = nullptr;
+      pending_.store(0u, std::memory_order_relaxed);
+    }
+    while (pending != nullptr) {
+      Watch* next = pending->next_;
+      fire(pending);
+      pending = next;
+    }
+  }
+
+  void shutdown() {
+    is_shutdown_.store(true, std::memory_order_release);
+    wake_up();
+  }
+
+  /* "events" is a set of EPOLLIN, EPOLLOUT, EPOLLPRI and EPOLLRDHUP, an error
+   * or a hang-up on the file descriptor fires the watch as well. The task is
+   * submitted by a portal, where other tasks of the same invoke may have been
+   * submitted already, so no error is thrown: if the file descriptor cannot
+   * be watched, such as a regular file or one that is watched already, or if
+   * the reactor is shut down, the task runs at once, and the procedure meets
+   * the error with its own I/O. Returns the error number, or 0. */
+  int watch(int fd, std::uint32_t events, Task&& task) {
+    Watch* watch;
+    {
+      allocation::Scope scope(allocation::Component::PORTAL);
+      watch = new Watch(fd, std::move(task));
+    }
+    epoll_event event{};
+    event.events = events | EPOLLONESHOT;
+    event.data.ptr = watch;
+    int error = ESHUTDOWN;
+    {
+      std::lock_guard<std::mutex> lk(mtx_);
+      if (!is_closed_) {
+        error = epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) == -1
+            ? errno : 0;
+      }
+      if (error == 0) {
+        link(*watch);
+      }
+    }
+    if (error != 0) {
+      std::unique_ptr<Watch> current(watch);
+      current->task_();
+    }
+    return error;
+  }
+
+  std::size_t pending() const {
+    return pending_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  struct Watch {
+    explicit Watch(int fd, Task&& task)
+        : fd_(fd), task_(std::move(task)), prev_(nullptr), next_(nullptr) {}
+
+    const int fd_;
+    Task task_;
+    Watch* prev_;
+    Watch* next_;
+  };
+
+  /* The pending watches are linked, so that they can be fired at shutdown */
+  void link(Watch& watch) {
+    watch.next_ = head_;
+    if (head_ != nullptr) {
+      head_->prev_ = &watch;
+    }
+    head_ = &watch;
+    pending_.fetch_add(1u, std::memory_order_relaxed);
+  }
+
+  void unlink(Watch& watch) {
+    (watch.prev_ == nullptr ? head_ : watch.prev_->next_) = watch.next_;
+    if (watch.next_ != nullptr) {
+      watch.next_->prev_ = watch.prev_;
+    }
+    pending_.fetch_sub(1u, std::memory_order_relaxed);
+  }
+
+  /* Removed before the task runs, so that the task may watch the same file
+   * descriptor again */
+  void fire(Watch* watch) {
+    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, watch->fd_, nullptr);
+    std::unique_ptr<Watch> current(watch);
+    current->task_();
+  }
+
+  void wake_up() {
+    std::uint64_t value = 1u;
+    if (write(event_fd_, &value, sizeof(value)) == -1) {}
+  }
+
+  void close_all() {
+    if (epoll_fd_ != -1) {
+      close(epoll_fd_);
+    }
+    if (event_fd_ != -1) {
+      close(event_fd_);
+    }
+  }
+
+  const int epoll_fd_;
+  const int event_fd_;
+  std::atomic_size_t pending_;
+  std::atomic_bool is_shutdown_;
+  std::mutex mtx_;
+  bool is_closed_;
+  Watch* head_;
+};
+
+/* Submits the tasks to the target portal once the file descriptor is ready
+ * for the events, so that a procedure doing I/O does not block a worker while
+ * waiting. The procedure is expected to do non-blocking I/O, and may submit
+ * itself again through the portal if the data is incomplete. The copies of a
+ * readiness portal, and the readiness portals made from it, share one reactor
+ * thread, which exits when the last of them is destroyed, after submitting
+ * the tasks of the watches still pending */
+template <class Portal = abstraction::ConcurrentCallablePortal,
+          class Task = abstraction::Runnable>
+class ReadinessPortal {
+  template <class, class>
+  friend class ReadinessPortal;
+
+ public:
+  template <class ReactorPortal = class ThreadPortal<false>>
+  explicit ReadinessPortal(
+      int fd, std::uint32_t events, const Portal& target,
+      const ReactorPortal& reactor_portal = ReactorPortal())
+      : fd_(fd), events_(events), target_(target) {
+    auto reactor = std::make_shared<Reactor<Task>>();
+    /* The reactor thread holds the reactor by itself, and the last portal
+     * shuts it down */
+    reactor_ = std::shared_ptr<Reactor<Task>>(
+        reactor.get(), [reactor](Reactor<Task>*) { reactor->shutdown(); });
+    reactor_portal([reactor] { reactor->execute(); });
+  }
+
+  /* Shares the reactor thread of another readiness portal */
+  template <class OtherPortal>
+  explicit ReadinessPortal(const ReadinessPortal<OtherPortal, Task>& reactor,
+                           int fd, std::uint32_t events, const Portal& target)
+      : fd_(fd), events_(events), target_(target), reactor_(reactor.reactor_) {}
+
+  ReadinessPortal(const ReadinessPortal&) = default;
+
+  ReadinessPortal& operator=(const ReadinessPortal&) = default;
+
+  template <class F, class... Args>
+  void operator()(F&& f, Args&&... args) const requires
+      requirements::Callable<F, void, Args...>() {
+    allocation::Scope scope(allocation::Component::PORTAL);
+    reactor_->watch(fd_, events_, Task(
+        [target = target_, f = std::decay_t<F>(std::forward<F>(f)),
+         args = std::make_tuple(std::forward<Args>(args)...)]() mutable {
+          std::apply([&](auto&... args) {
+            target(std::move(f), std::move(args)...);
+          }, args);
+        }));
+  }
+
+  int fd() const { return fd_; }
+
+  std::uint32_t events() const { return events_; }
+
+  std::size_t pending() const { return reactor_->pending(); }
+
+ private:
+  int fd_;
+  std::uint32_t events_;
+  Portal target_;
+  std::shared_ptr<Reactor<Task>> reactor_;
+};
+
+}
+
+#endif // __linux__
+
+#endif // _CON_LIB_REACTOR
@@ -0,0 +1,300 @@
+/** Copyright (C) 2015-2017 Mingxin Wang - All Rights Reserved.
+ *  This is a C++ header file, which is part of the implementation
+ *  for the Concurrent Support Library.
+ *
+ *  @file     concurrent.h
+ *  @author   Mingxin Wang
+ */
+
+#ifndef _CON_LIB_REDUCER
+#define _CON_LIB_REDUCER
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "core.hpp"
+#include "util.hpp"
+#include "allocation.hpp"
+
+namespace con {
+
+/* A monoid has a "value_type", makes its identity with identity(), and
+ * reduces the right value into the left one with reduce(left, right). The
+ * views of a reducer are merged in no particular order, so the operation
+ * shall be commutative as well as associative. */
+template <class T>
+class SumMonoid {
+ public:
+  using value_type = T;
+
+  T identity() const { return T(); }
+
+  void reduce(T& left, T&& right) const { left += right; }
+};
+
+template <class T>
+class MinMonoid {
+ public:
+  using value_type = T;
+
+  T identity() const { return std::numeric_limits<T>::max(); }
+
+  void reduce(T& left, T&& right) const {
+    if (right < left) {
+      left = std::move(right);
+    }
+  }
+};
+
+template <class T>
+class MaxMonoid {
+ public:
+  using value_type = T;
+
+  T identity() const { return std::numeric_limits<T>::lowest(); }
+
+  void reduce(T& left, T&& right) const {
+    if (left < right) {
+      left = std::move(right);
+    }
+  }
+};
+
+/* Counts per bin, the bins are indexed by the procedures */
+class HistogramMonoid {
+ public:
+  using value_type = std::vector<std::uint64_t>;
+
+  explicit HistogramMonoid(std::size_t bins) : bins_(bins) {}
+
+  value_type identity() const { return value_type(bins_, 0u); }
+
+  void reduce(value_type& left, value_type&& right) const {
+    for (std::size_t i = 0u; i < bins_; ++i) {
+      left[i] += right[i];
+    }
+  }
+
+ private:
+  std::size_t bins_;
+};
+
+/* The values appended by a thread stay in order, but the runs of different
+ * threads are concatenated in no particular order */
+template <class T>
+class AppendMonoid {
+ public:
+  using value_type = std::vector<T>;
+
+  value_type identity() const { return value_type(); }
+
+  void reduce(value_type& left, value_type&& right) const {
+    if (left.empty()) {
+      left.swap(right);
+    } else {
+      left.insert(left.end(), std::make_move_iterator(right.begin()),
+                  std::make_move_iterator(right.end()));
+      right.clear();
+    }
+  }
+};
+
+inline std::uint64_t next_reducer_id() {
+  static std::atomic<std::uint64_t> next(1u);
+  return next.fetch_add(1u, std::memory_order_relaxed);
+}
+
+/* The views a thread used last, indexed by the ids of the reducers. The ids
+ * are never reused, so an entry of a destroyed reducer never matches. */
+struct ReducerViewCacheEntry {
+  std::uint64_t id_;
+  void* view_;
+};
+
+constexpr std::size_t REDUCER_VIEW_CACHE_SIZE = 8u;
+
+inline ReducerViewCacheEntry& reducer_view_cache_entry(std::uint64_t id) {
+  static thread_local ReducerViewCacheEntry
+      cache[REDUCER_VIEW_CACHE_SIZE] = {};
+  return cache[id % REDUCER_VIEW_CACHE_SIZE];
+}
+
+/* Every thread that updates the reducer gets a private view that occupies
+ * whole cache lines, so that the procedures accumulate without sharing
+ * anything. The views are merged into the result by merge(), which
+ * ReducingConcurrentCallback calls when the last join fires, and are reset
+ * to the identity to be used by the next invoke. merge() shall not run
+ * concurrently with any update. */
+template <class Monoid>
+class Reducer {
+ public:
+  using value_type = typename Monoid::value_type;
+
+  explicit Reducer(const Monoid& monoid = Monoid())
+      : monoid_(monoid), id_(next_reducer_id()), head_(nullptr),
+        result_(monoid_.identity()) {}
+
+  Reducer(const Reducer&) = delete;
+
+  ~Reducer() {
+    View* current = head_.load(std::memory_order_acquire);
+    while (current != nullptr) {
+      View* next = current->next_;
+      delete current;
+      current = next;
+    }
+  }
+
+  /* The view of the calling thread */
+  value_type& view() {
+    ReducerViewCacheEntry& entry = reducer_view_cache_entry(id_);
+    if (entry.id_ != id_) {
+      entry.id_ = id_;
+      entry.view_ = find_or_make_view();
+    }
+    return static_cast<View*>(entry.view_)->value_;
+  }
+
+  void merge() {
+    for (View* current = head_.load(std::memory_order_acquire);
+         current != nullptr; current = current->next_) {
+      monoid_.reduce(result_, std::exchange(current->value_,
+                                            monoid_.identity()));
+    }
+  }
+
+  /* Merges what is left in the views, and returns the result */
+  value_type& get() {
+    merge();
+    return result_;
+  }
+
+  /* The result as of the last merge */
+  value_type& result() { return result_; }
+
+  void reset() {
+    merge();
+    result_ = monoid_.identity();
+  }
+
+  const Monoid& monoid() const { return monoid_; }
+
+ private:
+  struct alignas(CACHE_LINE_SIZE) View {
+    explicit View(value_type&& value)
+        : value_(std::move(value)), owner_(std::this_thread::get_id()),
+          next_(nullptr) {}
+
+    value_type value_;
+    const std::thread::id owner_;
+    View* next_;
+  };
+
+  /* The views are only ever pushed, so the list can be read without a lock
+   * while other threads are adding theirs */
+  View* find_or_make_view() {
+    std::thread::id self = std::this_thread::get_id();
+    View* head = head_.load(std::memory_order_acquire);
+    for (View* current = head; current != nullptr; current = current->next_) {
+      if (current->owner_ == self) {
+        return current;
+      }
+    }
+    View* view;
+    {
+      allocation::Scope scope(allocation::Component::CALLER);
+      view = new View(monoid_.identity());
+    }
+    view->next_ = head;
+    while (!head_.compare_exchange_weak(view->next_, view,
+                                        std::memory_order_release,
+                                        std::memory_order_relaxed)) {}
+    return view;
+  }
+
+  const Monoid monoid_;
+  const std::uint64_t id_;
+  std::atomic<View*> head_;
+  value_type result_;
+};
+
+/* Merges the views of the reducers when the last join fires, then calls the
+ * wrapped callback */
+template <class Callback, class... Reducers>
+class ReducingConcurrentCallback {
+ public:
+  explicit ReducingConcurrentCallback(const Callback& callback,
+                                      Reducers&... reducers)
+      : callback_(callback), reducers_(&reducers...) {}
+
+  ReducingConcurrentCallback(const ReducingConcurrentCallback&) = default;
+
+  ReducingConcurrentCallback& operator=(
+      const ReducingConcurrentCallback&) = default;
+
+  void operator()() const {
+    std::apply([](Reducers*... reducers) { (reducers->merge(), ...); },
+               reducers_);
+    callback_();
+  }
+
+ private:
+  Callback callback_;
+  std::tuple<Reducers*...> reducers_;
+};
+
+template <class Callback, class... Reducers>
+auto make_reducing_callback(const Callback& callback,
+                            Reducers&... reducers) {
+  return ReducingConcurrentCallback<Callback, Reducers...>(callback,
+                                                           reducers...);
+}
+
+template <class AtomicCounterInitializer,
+          class BinarySemaphore,
+          class Monoid,
+          class... ConcurrentCallers>
+auto& sync_concurrent_invoke_reduce_explicit(
+    AtomicCounterInitializer&& initializer,
+    BinarySemaphore&& semaphore,
+    Reducer<Monoid>& reducer,
+    ConcurrentCallers&&... callers) requires
+    requirements::AtomicCounterInitializer<AtomicCounterInitializer>() &&
+    requirements::BinarySemaphore<BinarySemaphore>() {
+  using Callback = SyncConcurrentCallback<
+      std::remove_reference_t<BinarySemaphore>>;
+  async_concurrent_invoke_explicit(
+      initializer,
+      ReducingConcurrentCallback<Callback, Reducer<Monoid>>(
+          Callback(semaphore), reducer),
+      callers...);
+  {
+    SyncInvokeHelper<std::remove_reference_t<BinarySemaphore>>
+        blocker(semaphore);
+  }
+  return reducer.result();
+}
+
+/* Invokes the callers, and returns the result of the reducer with the views
+ * merged when the last join fired */
+template <class Monoid, class... ConcurrentCallers>
+auto& sync_concurrent_invoke_reduce(Reducer<Monoid>& reducer,
+                                    ConcurrentCallers&&... callers) {
+  return sync_concurrent_invoke_reduce_explicit(
+      DefaultAtomicCounterInitializer(),
+      DefaultBinarySemaphore(),
+      reducer,
+      callers...);
+}
+
+}
+
+#endif // _CON_LIB_REDUCER
@@ -9,7 +9,9 @@
 #ifndef _CON_LIB_REQUIREMENTS
 #define _CON_LIB_REQUIREMENTS
 
+#include <cstddef>
 #include <functional>
+#include <type_traits>
 
 namespace con {
 
@@ -70,6 +72,13 @@ concept bool ConcurrentCaller() {
   };
 }
 
+template <class T>
+concept bool StaticConcurrentCaller() {
+  return requires {
+    typename std::integral_constant<std::size_t, T::size()>;
+  };
+}
+
 template <class T, class U, class V>
 constexpr bool concurrent_caller_all(T&, const U&, V&) {
   return ConcurrentCaller<V, T, U>();
@@ -0,0 +1,393 @@
+/** Copyright (C) 2015-2017 Mingxin Wang - All Rights Reserved.
+ *  This is a C++ header file, which is part of the implementation
+ *  for the Concurrent Support Library.
+ *
+ *  @file     concurrent.h
+ *  @author   Mingxin Wang
+ */
+
+#ifndef _CON_LIB_TIMER_WHEEL
+#define _CON_LIB_TIMER_WHEEL
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "requirements.hpp"
+#include "allocation.hpp"
+#include "abstraction.hpp"
+#include "portal.hpp"
+
+namespace con {
+
+/* Identifies a pending timer, a handle whose timer has fired or has been
+ * cancelled no longer matches anything, even if the node is reused */
+struct TimerHandle {
+  TimerHandle() : node_(nullptr), generation_(0u) {}
+
+  void* node_;
+  std::uint64_t generation_;
+};
+
+/* A hierarchical timing wheel driven by the thread that calls execute().
+ * Level i has SLOTS slots of SLOTS ^ i ticks each, a timer is linked into the
+ * lowest level that covers its delay and is cascaded to the lower levels as
+ * the time approaches, so that inserting and cancelling a timer are O(1).
+ * The thread wakes up at most once per SLOTS ticks when nothing is due, and
+ * the nodes are recycled, so that millions of pending timers cost little more
+ * than their tasks. */
+template <class Task = abstraction::Runnable>
+requires requirements::Runnable<Task>()
+class TimerWheel {
+ public:
+  static constexpr std::size_t LEVEL_BITS = 8u;
+  static constexpr std::size_t SLOTS = std::size_t(1u) << LEVEL_BITS;
+  static constexpr std::size_t LEVELS = 4u;
+
+  explicit TimerWheel(std::chrono::nanoseconds resolution)
+      : resolution_(std::max<std::int64_t>(resolution.count(), 1)),
+        start_(std::chrono::steady_clock::now()),
+        now_(0u),
+        wakeup_(NEVER),
+        pending_(0u),
+        free_(nullptr),
+        is_shutdown_(false) {
+    for (auto& level : slots_) {
+      level.fill(nullptr);
+    }
+  }
+
+  TimerWheel(const TimerWheel&) = delete;
+
+  /* Fires the timers until the wheel is shut down, then fires the pending
+   * ones at once, so that a long delay keeps neither the thread nor the
+   * invokes of the tasks waiting */
+  void execute() {
+    std::vector<Task> expired;
+    std::unique_lock<std::mutex> lk(mtx_);
+    for (;;) {
+      if (is_shutdown_) {
+        flush(expired);
+        lk.unlock();
+        for (Task& task : expired) {
+          task();
+        }
+        break;
+      }
+      if (pending_ == 0u) {
+        wakeup_ = NEVER;
+        cond_.wait(lk);
+        continue;
+      }
+      std::uint64_t current = current_tick();
+      while (now_ <= current && pending_ != 0u) {
+        advance(expired);
+      }
+      if (!expired.empty()) {
+        lk.unlock();
+        for (Task& task : expired) {
+          task();
+        }
+        expired.clear();
+        lk.lock();
+        continue;
+      }
+      if (pending_ != 0u) {
+        wakeup_ = next_event();
+        cond_.wait_until(lk, start_ + std::chrono::nanoseconds(
+            (std::int64_t)wakeup_ * resolution_));
+      }
+    }
+  }
+
+  void shutdown() {
+    {
+      std::lock_guard<std::mutex> lk(mtx_);
+      is_shutdown_ = true;
+    }
+    cond_.notify_all();
+  }
+
+  /* The task runs at once if the wheel is shut down */
+  TimerHandle schedule(std::chrono::nanoseconds delay, Task&& task) {
+    std::uint64_t deadline = deadline_tick(delay);
+    TimerHandle result;
+    bool notify;
+    {
+      std::unique_lock<std::mutex> lk(mtx_);
+      if (is_shutdown_) {
+        lk.unlock();
+        task();
+        return result;
+      }
+      if (pending_ == 0u) {
+        /* The clock has not been followed while the wheel was empty */
+        now_ = std::max(now_, current_tick());
+      }
+      Node* node = make_node(std::move(task));
+      node->deadline_ = std::max(deadline, now_);
+      link(node);
+      ++pending_;
+      result.node_ = node;
+      result.generation_ = node->generation_;
+      notify = node->deadline_ < wakeup_;
+    }
+    if (notify) {
+      cond_.notify_one();
+    }
+    return result;
+  }
+
+  /* Returns false if the timer has already fired or been cancelled */
+  bool cancel(const TimerHandle& handle) {
+    Node* node = static_cast<Node*>(handle.node_);
+    if (node == nullptr) {
+      return false;
+    }
+    std::unique_lock<std::mutex> lk(mtx_);
+    if (node->generation_ != handle.generation_) {
+      return false;
+    }
+    unlink(node);
+    --pending_;
+    /* The task is destroyed after unlocking */
+    Task task = release_node(node);
+    lk.unlock();
+    return true;
+  }
+
+  std::size_t pending() {
+    std::lock_guard<std::mutex> lk(mtx_);
+    return pending_;
+  }
+
+ private:
+  static constexpr std::uint64_t NEVER =
+      std::numeric_limits<std::uint64_t>::max();
+
+  struct Node {
+    explicit Node(Task&& task)
+        : next_(nullptr), pprev_(nullptr), deadline_(0u), generation_(0u),
+          task_(std::move(task)) {}
+
+    Node* next_;
+    /* The field pointing to this node, either a slot or the previous node */
+    Node** pprev_;
+    std::uint64_t deadline_;
+    /* Advanced whenever the node is released */
+    std::uint64_t generation_;
+    Task task_;
+  };
+
+  std::uint64_t current_tick() const {
+    return (std::uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start_).count() / resolution_;
+  }
+
+  /* Rounded up, so that a timer never fires before its delay */
+  std::uint64_t deadline_tick(std::chrono::nanoseconds delay) const {
+    std::int64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start_ + delay).count();
+    return ns <= 0 ? 0u : ((std::uint64_t)ns + resolution_ - 1u) / resolution_;
+  }
+
+  Node* make_node(Task&& task) {
+    allocation::Scope scope(allocation::Component::PORTAL);
+    Node* node = free_;
+    if (node == nullptr) {
+      nodes_.emplace_back(std::move(task));
+      return &nodes_.back();
+    }
+    free_ = node->next_;
+    node->task_ = std::move(task);
+    return node;
+  }
+
+  Task release_node(Node* node) {
+    Task result = std::move(node->task_);
+    ++node->generation_;
+    node->pprev_ = nullptr;
+    node->next_ = free_;
+    free_ = node;
+    return result;
+  }
+
+  void link(Node* node) {
+    std::uint64_t delta = node->deadline_ - now_;
+    std::size_t level = 0u;
+    std::uint64_t position = node->deadline_;
+    while (level + 1u < LEVELS &&
+           (delta >> (LEVEL_BITS * (level + 1u))) != 0u) {
+      ++level;
+    }
+    if (level + 1u == LEVELS && (delta >> (LEVEL_BITS * LEVELS)) != 0u) {
+      /* Beyond the range of the wheel, the timer is parked in the farthest
+       * slot and cascaded there again until it is in range */
+      position = now_ + (std::uint64_t(1u) << (LEVEL_BITS * LEVELS)) - 1u;
+    }
+    Node** slot =
+        &slots_[level][(position >> (LEVEL_BITS * level)) & (SLOTS - 1u)];
+    node->next_ = *slot;
+    if (node->next_ != nullptr) {
+      node->next_->pprev_ = &node->next_;
+    }
+    node->pprev_ = slot;
+    *slot = node;
+  }
+
+  void unlink(Node* node) {
+    *node->pprev_ = node->next_;
+    if (node->next_ != nullptr) {
+      node->next_->pprev_ = node->pprev_;
+    }
+  }
+
+  /* Processes tick now_, the timers due are moved to "expired" */
+  void advance(std::vector<Task>& expired) {
+    for (std::size_t level = 1u; level < LEVELS; ++level) {
+      if ((now_ & ((std::uint64_t(1u) << (LEVEL_BITS * level)) - 1u)) != 0u) {
+        break;
+      }
+      std::size_t index = (now_ >> (LEVEL_BITS * level)) & (SLOTS - 1u);
+      Node* node = std::exchange(slots_[level][index], nullptr);
+      while (node != nullptr) {
+        Node* next = node->next_;
+        link(node);
+        node = next;
+      }
+    }
+    Node* node = std::exchange(slots_[0u][now_ & (SLOTS - 1u)], nullptr);
+    while (node != nullptr) {
+      Node* next = node->next_;
+      expired.push_back(release_node(node));
+      --pending_;
+      node = next;
+    }
+    ++now_;
+  }
+
+  /* Moves every pending timer to "expired", the ones due first first */
+  void flush(std::vector<Task>& expired) {
+    for (std::size_t level = 0u; level < LEVELS; ++level) {
+      std::size_t first = (now_ >> (LEVEL_BITS * level)) & (SLOTS - 1u);
+      for (std::size_t i = 0u; i < SLOTS; ++i) {
+        Node* node = std::exchange(
+            slots_[level][(first + i) & (SLOTS - 1u)], nullptr);
+        while (node != nullptr) {
+          Node* next = node->next_;
+          expired.push_back(release_node(node));
+          node = next;
+        }
+      }
+    }
+    pending_ = 0u;
+  }
+
+  /* The first tick from now_ on that has due timers or a cascade */
+  std::uint64_t next_event() const {
+    std::uint64_t tick = now_;
+    while ((tick & (SLOTS - 1u)) != 0u &&
+           slots_[0u][tick & (SLOTS - 1u)] == nullptr) {
+      ++tick;
+    }
+    return tick;
+  }
+
+  const std::uint64_t resolution_;
+  const std::chrono::steady_clock::time_point start_;
+  std::mutex mtx_;
+  std::condition_variable cond_;
+  /* The next tick to process */
+  std::uint64_t now_;
+  /* The tick the timer thread sleeps until */
+  std::uint64_t wakeup_;
+  std::size_t pending_;
+  std::array<std::array<Node*, SLOTS>, LEVELS> slots_;
+  /* The nodes never move, and the released ones are chained by next_ */
+  std::deque<Node> nodes_;
+  Node* free_;
+  bool is_shutdown_;
+};
+
+/* Submits the tasks to the target portal after a delay, as they are
+ * submitted to the delay portal. The copies of a
+ * delay portal, and the delay portals made from it, share one timer thread,
+ * which fires the pending timers at once and exits when the last of them is
+ * destroyed */
+template <class Portal = abstraction::ConcurrentCallablePortal,
+          class Task = abstraction::Runnable>
+class DelayPortal {
+  template <class, class>
+  friend class DelayPortal;
+
+ public:
+  template <class TimerPortal = class ThreadPortal<false>>
+  explicit DelayPortal(
+      std::chrono::nanoseconds delay, const Portal& target,
+      std::chrono::nanoseconds resolution = std::chrono::milliseconds(1),
+      const TimerPortal& timer_portal = TimerPortal())
+      : delay_(delay), target_(target) {
+    auto wheel = std::make_shared<TimerWheel<Task>>(resolution);
+    /* The timer thread holds the wheel by itself, and the last portal shuts
+     * it down */
+    wheel_ = std::shared_ptr<TimerWheel<Task>>(
+        wheel.get(), [wheel](TimerWheel<Task>*) { wheel->shutdown(); });
+    timer_portal([wheel] { wheel->execute(); });
+  }
+
+  /* Shares the timer thread of another delay portal */
+  template <class OtherPortal>
+  explicit DelayPortal(const DelayPortal<OtherPortal, Task>& timer,
+                       std::chrono::nanoseconds delay, const Portal& target)
+      : delay_(delay), target_(target), wheel_(timer.wheel_) {}
+
+  DelayPortal(const DelayPortal&) = default;
+
+  DelayPortal& operator=(const DelayPortal&) = default;
+
+  template <class F, class... Args>
+  void operator()(F&& f, Args&&... args) const requires
+      requirements::Callable<F, void, Args...>() {
+    schedule_after(delay_, std::forward<F>(f), std::forward<Args>(args)...);
+  }
+
+  template <class F, class... Args>
+  TimerHandle schedule_after(std::chrono::nanoseconds delay, F&& f,
+                             Args&&... args) const requires
+      requirements::Callable<F, void, Args...>() {
+    allocation::Scope scope(allocation::Component::PORTAL);
+    return wheel_->schedule(delay, Task(
+        [target = target_, f = std::decay_t<F>(std::forward<F>(f)),
+         args = std::make_tuple(std::forward<Args>(args)...)]() mutable {
+          std::apply([&](auto&... args) {
+            target(std::move(f), std::move(args)...);
+          }, args);
+        }));
+  }
+
+  bool cancel(const TimerHandle& handle) const {
+    return wheel_->cancel(handle);
+  }
+
+  std::size_t pending() const { return wheel_->pending(); }
+
+  std::chrono::nanoseconds delay() const { return delay_; }
+
+ private:
+  std::chrono::nanoseconds delay_;
+  Portal target_;
+  std::shared_ptr<TimerWheel<Task>> wheel_;
+};
+
+}
+
+#endif // _CON_LIB_TIMER_WHEEL
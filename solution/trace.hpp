@@ -0,0 +1,272 @@
+/** Copyright (C) 2015-2017 Mingxin Wang - All Rights Reserved.
+ *  This is a C++ header file, which is part of the implementation
+ *  for the Concurrent Support Library.
+ *
+ *  @file     concurrent.h
+ *  @author   Mingxin Wang
+ */
+
+#ifndef _CON_LIB_TRACE
+#define _CON_LIB_TRACE
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <type_traits>
+#include <utility>
+
+#ifdef CON_LIB_TRACE
+#include <atomic>
+#include <chrono>
+#endif // CON_LIB_TRACE
+
+namespace con {
+
+/* Tracing is compiled in only when CON_LIB_TRACE is defined, otherwise every
+ * function in this namespace is empty and the tasks are not wrapped. Each
+ * thread records into its own ring buffer, dump() writes the events in the
+ * Chrome trace_event format and shall be called when the traced tasks are
+ * quiescent. */
+namespace trace {
+
+#ifdef CON_LIB_TRACE
+
+#ifndef CON_LIB_TRACE_BUFFER_SIZE
+#define CON_LIB_TRACE_BUFFER_SIZE (1u << 16)
+#endif // CON_LIB_TRACE_BUFFER_SIZE
+
+enum class EventType : std::uint8_t {
+  SUBMIT, DEQUEUE, START, END, JOIN, WAIT_BEGIN, WAIT_END
+};
+
+struct Event {
+  std::uint64_t timestamp_;
+  std::uint64_t task_;
+  EventType type_;
+};
+
+/* Written only by the owning thread. The buffers are never freed, so that
+ * they can be dumped after the threads exit, but a buffer is handed back when
+ * its thread exits and is reused by the next thread that traces, so that
+ * there are no more buffers than threads that ever traced at the same time.
+ * The events of the next thread continue the ring under the same tid. */
+class ThreadBuffer {
+ public:
+  explicit ThreadBuffer(std::size_t worker_id)
+      : worker_id_(worker_id), size_(0u), owned_(true), next_(nullptr) {}
+
+  void record(EventType type, std::uint64_t task) {
+    std::size_t size = size_.load(std::memory_order_relaxed);
+    Event& event = events_[size % CON_LIB_TRACE_BUFFER_SIZE];
+    event.timestamp_ = (std::uint64_t)
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    event.task_ = task;
+    event.type_ = type;
+    size_.store(size + 1u, std::memory_order_release);
+  }
+
+  const std::size_t worker_id_;
+  std::atomic_size_t size_;
+  std::atomic_bool owned_;
+  ThreadBuffer* next_;
+  Event events_[CON_LIB_TRACE_BUFFER_SIZE];
+};
+
+inline std::atomic<ThreadBuffer*>& buffers() {
+  static std::atomic<ThreadBuffer*> head(nullptr);
+  return head;
+}
+
+/* Takes a buffer handed back by an exited thread, or makes a new one */
+inline ThreadBuffer* acquire_buffer() {
+  static std::atomic_size_t worker_count(0u);
+  for (ThreadBuffer* buffer = buffers().load(std::memory_order_acquire);
+       buffer != nullptr; buffer = buffer->next_) {
+    bool owned = false;
+    if (!buffer->owned_.load(std::memory_order_relaxed) &&
+        buffer->owned_.compare_exchange_strong(owned, true,
+                                               std::memory_order_acquire)) {
+      return buffer;
+    }
+  }
+  ThreadBuffer* result = new ThreadBuffer(
+      worker_count.fetch_add(1u, std::memory_order_relaxed));
+  result->next_ = buffers().load(std::memory_order_relaxed);
+  while (!buffers().compare_exchange_weak(result->next_, result,
+                                          std::memory_order_release,
+                                          std::memory_order_relaxed)) {}
+  return result;
+}
+
+/* Hands the buffer of the thread back when the thread exits */
+class ThreadBufferOwner {
+ public:
+  ThreadBufferOwner() : buffer_(acquire_buffer()) {}
+
+  ThreadBufferOwner(const ThreadBufferOwner&) = delete;
+
+  ~ThreadBufferOwner() {
+    buffer_->owned_.store(false, std::memory_order_release);
+  }
+
+  ThreadBuffer* const buffer_;
+};
+
+inline ThreadBuffer& local_buffer() {
+  static thread_local ThreadBufferOwner owner;
+  return *owner.buffer_;
+}
+
+/* The buffers made so far, each one is CON_LIB_TRACE_BUFFER_SIZE events */
+inline std::size_t buffer_count() {
+  std::size_t result = 0u;
+  for (ThreadBuffer* buffer = buffers().load(std::memory_order_acquire);
+       buffer != nullptr; buffer = buffer->next_) {
+    ++result;
+  }
+  return result;
+}
+
+inline std::uint64_t& current_task() {
+  static thread_local std::uint64_t task = 0u;
+  return task;
+}
+
+inline std::uint64_t next_task() {
+  static std::atomic<std::uint64_t> count(0u);
+  return count.fetch_add(1u, std::memory_order_relaxed) + 1u;
+}
+
+/* Records the submission when constructed, and the dequeue when the
+ * execution agent starts running it */
+template <class F>
+class TracedTask {
+ public:
+  explicit TracedTask(F&& f)
+      : f_(std::forward<F>(f)), task_(next_task()) {
+    local_buffer().record(EventType::SUBMIT, task_);
+  }
+
+  template <class... Args>
+  void operator()(Args&&... args) {
+    local_buffer().record(EventType::DEQUEUE, task_);
+    std::uint64_t previous = current_task();
+    current_task() = task_;
+    f_(std::forward<Args>(args)...);
+    current_task() = previous;
+  }
+
+ private:
+  std::decay_t<F> f_;
+  std::uint64_t task_;
+};
+
+template <class F>
+auto wrap(F&& f) {
+  return TracedTask<F>(std::forward<F>(f));
+}
+
+/* Records the start and the end of a procedure, a procedure that was not
+ * submitted with a traced portal gets a new task id */
+class TaskScope {
+ public:
+  TaskScope() : previous_(current_task()) {
+    if (previous_ == 0u) {
+      current_task() = next_task();
+    }
+    local_buffer().record(EventType::START, current_task());
+  }
+
+  TaskScope(const TaskScope&) = delete;
+
+  ~TaskScope() {
+    local_buffer().record(EventType::END, current_task());
+    current_task() = previous_;
+  }
+
+ private:
+  const std::uint64_t previous_;
+};
+
+inline void join() { local_buffer().record(EventType::JOIN, current_task()); }
+
+inline void wait_begin() { local_buffer().record(EventType::WAIT_BEGIN, 0u); }
+
+inline void wait_end() { local_buffer().record(EventType::WAIT_END, 0u); }
+
+/* Chrome expects microseconds */
+inline void write_timestamp(std::ostream& out, std::uint64_t ns) {
+  out << ns / 1000u << "." << (ns / 100u) % 10u << (ns / 10u) % 10u
+      << ns % 10u;
+}
+
+inline void dump(std::ostream& out) {
+  static const char* const NAMES[] = {
+      "submit", "dequeue", "task", "task", "join", "sync_wait", "sync_wait"};
+  static const char* const PHASES[] = {"i", "i", "B", "E", "i", "B", "E"};
+  out << "{\"traceEvents\":[";
+  bool first = true;
+  for (ThreadBuffer* buffer = buffers().load(std::memory_order_acquire);
+       buffer != nullptr; buffer = buffer->next_) {
+    std::size_t last = buffer->size_.load(std::memory_order_acquire),
+                begin = last > CON_LIB_TRACE_BUFFER_SIZE
+                    ? last - CON_LIB_TRACE_BUFFER_SIZE : 0u;
+    for (std::size_t i = begin; i < last; ++i) {
+      const Event& event = buffer->events_[i % CON_LIB_TRACE_BUFFER_SIZE];
+      std::size_t type = (std::size_t)event.type_;
+      out << (first ? "\n" : ",\n") << "{\"name\":\"" << NAMES[type]
+          << "\",\"cat\":\"con\",\"ph\":\"" << PHASES[type] << "\",\"ts\":";
+      write_timestamp(out, event.timestamp_);
+      out << ",\"pid\":0,\"tid\":" << buffer->worker_id_;
+      if (PHASES[type][0] == 'i') {
+        out << ",\"s\":\"t\"";
+      }
+      if (event.task_ != 0u) {
+        out << ",\"args\":{\"task\":" << event.task_ << "}";
+      }
+      out << "}";
+      /* An arrow is drawn from the submission to the dequeue */
+      if (event.type_ == EventType::SUBMIT ||
+          event.type_ == EventType::DEQUEUE) {
+        out << ",\n{\"name\":\"queue\",\"cat\":\"con\",\"ph\":\""
+            << (event.type_ == EventType::SUBMIT ? "s" : "f")
+            << "\",\"bp\":\"e\",\"id\":" << event.task_ << ",\"ts\":";
+        write_timestamp(out, event.timestamp_);
+        out << ",\"pid\":0,\"tid\":" << buffer->worker_id_ << "}";
+      }
+      first = false;
+    }
+  }
+  out << "\n]}\n";
+}
+
+#else
+
+template <class F>
+F&& wrap(F&& f) { return std::forward<F>(f); }
+
+class TaskScope {
+ public:
+  TaskScope() {}
+
+  TaskScope(const TaskScope&) = delete;
+};
+
+inline void join() {}
+
+inline void wait_begin() {}
+
+inline void wait_end() {}
+
+inline std::size_t buffer_count() { return 0u; }
+
+inline void dump(std::ostream& out) { out << "{\"traceEvents\":[]}\n"; }
+
+#endif // CON_LIB_TRACE
+
+}
+
+}
+
+#endif // _CON_LIB_TRACE
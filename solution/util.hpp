@@ -9,10 +9,115 @@
 #ifndef _CON_LIB_UTIL
 #define _CON_LIB_UTIL
 
+#include <cstddef>
 #include <functional>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
 
 namespace con {
 
+constexpr std::size_t CACHE_LINE_SIZE = 64u;
+
+/* Occupies whole cache lines, so that adjacent values do not false share */
+template <class T>
+struct alignas(CACHE_LINE_SIZE) CacheLineStorage {
+  T value_;
+};
+
+/* A sequence that keeps up to N elements inline, and moves all of them to
+ * the heap once there are more, so that a few elements cost no allocation */
+template <class T, std::size_t N>
+class SmallVector {
+ public:
+  SmallVector() : data_(inline_data()), size_(0u), capacity_(N) {}
+
+  SmallVector(const SmallVector& rhs) : SmallVector() {
+    reserve(rhs.size_);
+    for (const T& value : rhs) {
+      emplace_back(value);
+    }
+  }
+
+  SmallVector(SmallVector&& rhs) : SmallVector() {
+    if (rhs.is_inline()) {
+      for (T& value : rhs) {
+        emplace_back(std::move(value));
+      }
+      rhs.clear();
+    } else {
+      data_ = std::exchange(rhs.data_, rhs.inline_data());
+      size_ = std::exchange(rhs.size_, 0u);
+      capacity_ = std::exchange(rhs.capacity_, N);
+    }
+  }
+
+  ~SmallVector() {
+    clear();
+    if (!is_inline()) {
+      std::allocator<T>().deallocate(data_, capacity_);
+    }
+  }
+
+  template <class... Args>
+  T& emplace_back(Args&&... args) {
+    if (size_ == capacity_) {
+      reserve(capacity_ * 2u);
+    }
+    T* result = new (data_ + size_) T(std::forward<Args>(args)...);
+    ++size_;
+    return *result;
+  }
+
+  void reserve(std::size_t capacity) {
+    if (capacity <= capacity_) {
+      return;
+    }
+    T* data = std::allocator<T>().allocate(capacity);
+    for (std::size_t i = 0u; i < size_; ++i) {
+      new (data + i) T(std::move(data_[i]));
+      data_[i].~T();
+    }
+    if (!is_inline()) {
+      std::allocator<T>().deallocate(data_, capacity_);
+    }
+    data_ = data;
+    capacity_ = capacity;
+  }
+
+  void clear() {
+    while (size_ > 0u) {
+      data_[--size_].~T();
+    }
+  }
+
+  std::size_t size() const { return size_; }
+  bool empty() const { return size_ == 0u; }
+  bool is_inline() const { return data_ == inline_data(); }
+
+  T& operator[](std::size_t i) { return data_[i]; }
+  const T& operator[](std::size_t i) const { return data_[i]; }
+  T* begin() { return data_; }
+  T* end() { return data_ + size_; }
+  const T* begin() const { return data_; }
+  const T* end() const { return data_ + size_; }
+
+ private:
+  static_assert(N > 0u, "A SmallVector keeps at least one element inline");
+
+  T* inline_data() { return reinterpret_cast<T*>(&inline_); }
+
+  const T* inline_data() const {
+    return reinterpret_cast<const T*>(&inline_);
+  }
+
+  std::aligned_storage_t<sizeof(T) * N, alignof(T)> inline_;
+  T* data_;
+  std::size_t size_;
+  std::size_t capacity_;
+};
+
 template <class T>
 T copy_construct(const T& rhs) {
   return T(rhs);